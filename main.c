@@ -7,20 +7,36 @@
 #include <string.h>                     // Strings are used to modify addresses and names (strcmp, strspy, ...)
 
 #include <math.h>                       // Helps with the mathematic problems that couldn't be solved without it
-
-#define REFRESH_TIME 100                // Frequency of refreshing the screen
+#include <limits.h>                     // INT_MAX used as "no limit" for straight flight
+#include <stdint.h>                     // Fixed width integers of the random generator and replay files
+#include <stddef.h>                     // offsetof for the keys of the level file
+#include <sys/stat.h>                   // mkdir for the replays folder
+#include <sys/resource.h>               // Peak memory of the benchmark (getrusage)
+#include <pthread.h>                    // Worker threads of the batch mode
+#include <fcntl.h>                      // open for the ranking files
+#include <sys/mman.h>                   // Ranking files are mapped into memory to read them
+#include <sys/file.h>                   // flock of the ranking files shared by many games
+#include <sys/wait.h>                   // Waiting for the writers of the ranking stress test
+#include <sys/inotify.h>                // Watching the level file while the game is running
+#include "telemetry.h"                  // Live counters in shared memory, the same layout as pp1-top reads
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>                  // SSE2 and AVX2 intrinsics for the proximity kernels
+#endif
+
+#define DEFAULT_TICK_RATE 10            // Ticks per second when level doesn't say otherwise
+#define MAX_CATCHUP_TICKS 5             // Maximum amound of missed ticks simulated before the next frame
 #define START_PLAYER_SPEED 1            // Speed that player have on the start of a game       
-#define MAX_LEVELS_COUNT 5              // Maximum amound of possible levels
+#define LEVELS_SHOWN 20                 // Level names printed when the player chooses a level
 
 #define ESCAPE      'q'                 // Button to quit the game
 #define REPEAT      'r'                 // Button to play again
 #define SAFE_ZONE   ' '                 // Button to call the taxi
+#define PROFILE_KEY 't'                 // Button to show or hide the timings of the frame in the ranking window
 
 #define BORDER		1		            // Border width (in characters)
 #define OFFY		5		            // Y offset from top of screen
 #define LIFEWINY    3		            // Height of life status window
 #define OFFX		5		            // X offset from left of screen
-#define RANKING_COLS 50                 // Width of the ranking table
 
 #define MAIN_COLOR	            1		// Main window color
 #define STAT_COLOR	            2		// Status bar color
@@ -37,6 +53,84 @@
 #define BOSS_COLOR              13      // Color of a Boss
 #define RANKING_COLOR           14      // Color of the score table
 
+#define ARENA_ALIGN             16      // Every object in the arena starts at the multiple of it
+#define ARENA_SIZE(bytes)       (((bytes) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN) // Bytes taken by an object
+#define MASK_WORDS(count)       (((count) + 31) / 32) // Words of a bitmask with one bit per object
+#define KERNEL_BENCH_COUNT      4096    // Objects tested by the kernel benchmark when count isn't given
+#define STRESS_LEVEL            "ranking-stress"    // Level of the ranking files written by the ranking stress test
+#define STRESS_WRITERS          100     // Games started at once by the ranking stress test when their number isn't given
+#define STRESS_SCORES           20      // Scores recorded by every game of the ranking stress test when their number isn't given
+
+#define REPLAY_MAGIC            "PP1R"  // First bytes of every replay file
+#define REPLAY_VERSION          1       // Version of the replay file layout
+#define CONFIG_CACHE_MAGIC      "PP1C"  // First bytes of every compiled config in the cache
+#define CONFIG_CACHE_VERSION    1       // Version of the compiled config layout
+#define CATALOG_MAGIC           "PP1L"  // First bytes of the level catalog in the cache
+#define CATALOG_VERSION         1       // Version of the level catalog layout
+#define LEVEL_NAME              50      // Bytes of a level name (the same as the level of the ranking)
+#define REPLAY_NO_KEY           255     // Byte of a tick without any key pressed
+#define REPLAYS_DIR             "replays" // Folder where every round is recorded
+
+#define BENCH_TICKS             20000   // Ticks simulated on every level by the benchmark when count isn't given
+#define BENCH_SEED              2024    // Seed of the random keys pressed in the benchmark
+#define BATCH_SESSIONS          100     // Sessions played by the batch mode when count isn't given
+
+#define PROFILE_INPUT           0       // Parts of a frame measured by the profile: reading the key
+#define PROFILE_COLLISIONS      1       // Swallow flight and its collisions
+#define PROFILE_STARS           2
+#define PROFILE_BOSS            3
+#define PROFILE_TAXI            4       // Taxi and the safe zone
+#define PROFILE_HUNTERS         5
+#define PROFILE_CLEAR           6       // Cleaning cells of the last frame
+#define PROFILE_DRAWING         7       // Drawing into the framebuffer, without sending it to the terminal
+#define PROFILE_HUD             8       // Life, time and status windows
+#define PROFILE_REFRESH         9       // Sending the frame to the terminal
+#define PROFILE_PARTS           10
+#define PROFILE_STEPS           4       // Histogram buckets for every power of two nanoseconds
+#define PROFILE_BUCKETS         256     // Histogram buckets of a part (enough for every long long)
+#define TRACE_RECORDS           4096    // Frames in a buffer of the trace, a full buffer goes to the writer thread
+
+#define KEYS_STREAM             0       // Random stream of the keys pressed by the random player
+#define RANKING_MAGIC           "PP1K"  // First bytes of every ranking file
+#define RANKING_VERSION         2       // Version of the ranking file layout
+#define RANKING_INDEXED         1       // Version that also had nick and points indexes after the records (still read)
+#define RANKING_NICK            100     // Bytes of a nick in the ranking (the same as the players name)
+#define JOURNAL_MIN             64      // Scores in the journal before it is folded into the ranking file
+#define SKIP_LEVELS             32      // Levels of the skip list that keeps the ranking sorted
+#define RANKING_STREAM          4       // Random stream of the skip list levels
+
+#define STARS_STREAM            1       // Random streams of the game, every kind of object draws from its own
+#define HUNTERS_STREAM          2
+#define BOSS_STREAM             3
+
+#ifdef DEBUG_ALLOCATIONS                // Compile with -DDEBUG_ALLOCATIONS to count heap allocations of the game
+long allocationCount = 0;               // Number of malloc, calloc and realloc calls made by the game code (not by the libraries)
+
+// Counts the allocation and passes it to malloc
+void* CountedMalloc(size_t size)
+{
+    allocationCount++;
+    return malloc(size);
+}
+
+// Counts the allocation and passes it to calloc
+void* CountedCalloc(size_t count, size_t size)
+{
+    allocationCount++;
+    return calloc(count, size);
+}
+
+// Counts the allocation and passes it to realloc
+void* CountedRealloc(void* memory, size_t size)
+{
+    allocationCount++;
+    return realloc(memory, size);
+}
+#define malloc(size) CountedMalloc(size)
+#define calloc(count, size) CountedCalloc(count, size)
+#define realloc(memory, size) CountedRealloc(memory, size)
+#endif
+
 typedef struct {                        // Structure of config file
 
     float start_time;                   // Time to survive in the game
@@ -56,18 +150,89 @@ typedef struct {                        // Structure of config file
     int max_boss_speed;                 // Bosses speed at maximum
     int boss_enter_part;                // The part in which boss enteres the game (2 -> 1/2, 3 -> 2/3)
     int boss_damage;                    // Damage that boss gives to swallow
+    int tick_rate;                      // How many times per second the game is updated
 
 } CONFIG_FILE;
 
+typedef struct {                        // Key of the level file, its value has to be in the range
+
+    const char* name;                   // Name of the key in the file ("max stars count")
+    size_t offset;                      // Place of the value in CONFIG_FILE
+    bool isFloat;                       // The value is a float (the others are ints)
+    double defaultValue;                // Value of the key missing in the file
+    double min;                         // Smallest value allowed
+    double max;                         // Biggest value allowed
+
+} CONFIG_KEY;
+
+typedef struct {                        // Header of a compiled config in the cache, followed by the CONFIG_FILE
+
+    char magic[4];                      // CONFIG_CACHE_MAGIC
+    uint32_t version;                   // CONFIG_CACHE_VERSION
+    uint32_t configSize;                // sizeof(CONFIG_FILE) of the program that wrote it
+    int64_t modified;                   // Time the level file was changed (nanoseconds), the cache is used only if it is the same
+    int64_t size;                       // Size of the level file
+
+} CONFIG_CACHE_HEADER;
+
+typedef struct {                        // Level file from the levels folder
+
+    char name[LEVEL_NAME];              // Name of the file
+    CONFIG_FILE* config;                // Config of the level, read the first time it is needed (NULL before)
+
+} LEVEL;
+
+typedef struct {                        // Levels of the levels folder sorted by name, the folder is read again only when it changes
+
+    LEVEL* levels;                      // Levels sorted by name
+    int count;                          // Number of levels
+    int capacity;                       // Number of levels that fit in the array
+    bool scanned;                       // False till the list is made for the first time
+    int64_t modified;                   // Time the folder was changed when the list was made (nanoseconds)
+
+} LEVEL_CATALOG;
+
+typedef struct {                        // Header of the level catalog in the cache, followed by the names of the levels
+
+    char magic[4];                      // CATALOG_MAGIC
+    uint32_t version;                   // CATALOG_VERSION
+    int64_t modified;                   // Time the levels folder was changed when the catalog was made (nanoseconds)
+    uint32_t count;                     // Number of names
+    uint32_t nameSize;                  // LEVEL_NAME of the program that wrote it
+
+} CATALOG_HEADER;
+
+typedef struct {                        // Watch of the played level file, changes are used from the next round
+
+    int fd;                             // inotify descriptor (-1 if the level isnt watched)
+    char name[100];                     // Name of the level file in its folder
+
+} LEVEL_WATCH;
+
 typedef struct {                // Structure of the windows inside the game
 
 	WINDOW* window;             // ncurses window pointer
 	int x, y;                   // Position on screen
 	int rows, cols;             // Size of window
 	int color;		            // Color scheme
+    struct FRAMEBUFFER* frame;  // Off-screen picture of the window (NULL if objects aren't drawn in it)
+    int pen;                    // Color used by DrawCell
 
 } WIN;
 
+typedef struct FRAMEBUFFER {    // Off-screen picture of a window, cells are glyphs packed with their color pair
+
+    chtype* background;         // Empty window (border and spaces)
+    chtype* cells;              // Frame being drawn
+    chtype* shown;              // Frame that is already in the ncurses window
+    int* drawnCells;            // Cells drawn since the last cleaning (y*cols + x)
+    int drawnCount;             // Number of remembered drawn cells
+    bool drawnOverflow;         // Too many cells to remember, the next cleaning clears whole frame
+    int* dirtyFrom;             // First column of every row that may differ from the shown frame
+    int* dirtyTo;               // Last column of every row that may differ from the shown frame
+
+} FRAMEBUFFER;
+
 typedef struct {                //Structure of the swallow
 
 	WIN* playWin;               // Play Window where swallow is shown
@@ -81,34 +246,74 @@ typedef struct {                //Structure of the swallow
 
 } Swallow;
 
-typedef struct {                // Structure of single hunter
-
-	WIN* playWin;               // Play Window where hunter is shown
-	int x, y;		            // Position on screen
-    int size;                   // Size of Hunter (1-3)
-	int color;		            // Color scheme
-    int dx;                     // direction to move the hunter
-    float a, b;                 // Values of func to move hunter y=ax+b
-    int speed;                  // Hunters speed
-	int animationFrame;		    // Animation frame of hunter
-    int boundsCounter;		    // Value of possible bounds
-    short int onTheScreen;		// Says if the hunter already jumped on the screen (0-1)
-    short int huntersStage;     // The stage of hunter patroling protocol
-    float hunterWaitTime;       // Time in seconds between the hunter stops and flies to intercept
-
-} Hunter;
-
-typedef struct {                // Structure of single star
-
-	WIN* playWin;               // Play Window where star is shown
-	int x, y;		            // Position on screen
-    int fallingSpeed;           // Stars falling speed
-	int color;		            // Color scheme
+typedef struct {                // Random generator (xoshiro128**), state of a single stream of numbers
+
+    uint32_t state[4];          // Never all zero
+
+} RANDOM;
+
+typedef struct {                // Objects found in the grid, gathered into arrays to be tested against the swallow at once
+
+    int count;                  // Number of gathered objects
+    int* x;                     // Positions of the objects
+    int* y;
+    float* hitRange;            // Squared distance at which the object hits the swallow
+    float* seeRange;            // Squared distance at which the object sees the swallow (-1 if it doesnt look)
+    unsigned* hit;              // Bit k is set if object k is in its hit range
+    unsigned* see;              // Bit k is set if object k is in its see range
+
+} BATCH;
+
+typedef struct {                // Uniform grid over the play area, every cell links the objects that are inside it
+
+    int cellSize;               // Width and height of a single cell (power of two)
+    int cellShift;              // Cell of a position is position >> cellShift
+    int rows, cols;             // Number of cells
+    int* head;                  // First object of every cell (-1 if the cell is empty)
+    int* next;                  // Next object in the same cell (-1 at the end)
+    int* prev;                  // Previous object in the same cell (-1 at the start)
+    int* cell;                  // Cell of every object (-1 if it isn't in the grid)
+    int* found;                 // Objects found by the last query
+    BATCH* batch;               // Found objects gathered for the proximity kernels
+    long tests;                 // Objects returned by every query, each of them is tested for a collision
+
+} GRID;
+
+typedef struct {                // Structure of all hunters, every property has its own array (index is the hunter)
+
+    int count;                  // Number of hunters
+	int* x;                     // Positions on screen
+	int* y;
+    int* size;                  // Sizes of Hunters (1-3)
+    int* dx;                    // directions to move the hunters
+    float* a;                   // Values of func to move hunter y=ax+b
+    float* b;
+    int* speed;                 // Hunters speeds
+	int* animationFrame;		// Animation frames of hunters
+    int* boundsCounter;		    // Values of possible bounds
+    short int* onTheScreen;		// Says if the hunter already jumped on the screen (0-1)
+    short int* huntersStage;    // The stage of hunter patroling protocol
+    float* hunterWaitTime;      // Time in seconds between the hunter stops and flies to intercept
+	int color;		            // Color scheme (same for every hunter)
+    GRID* grid;                 // Hunters sorted into cells, to check only hunters near the swallow
+    RANDOM random;              // Random stream of the hunters
+
+} Hunters;
+
+typedef struct {                // Structure of all stars, every property has its own array (index is the star)
+
+    int count;                  // Number of stars
+	int* x;                     // Positions on screen
+	int* y;
+    int* fallingSpeed;          // Stars falling speeds
+    int* animationFrame;		// Frames of blinking
+	int color;		            // Color scheme (same for every star)
 	int color2;		            // Color scheme while shifting
-    int animationFrame;		    // Color scheme
-    int stars_scoring_weight;	// how much points will swallow get from it
+    int stars_scoring_weight;	// how much points will swallow get from a star
+    GRID* grid;                 // Stars sorted into cells, to check only stars near the swallow
+    RANDOM random;              // Random stream of the stars
 
-} Star;
+} Stars;
 
 typedef struct {                // Structure of the safe zone
 
@@ -144,19 +349,399 @@ typedef struct {                // Structure of the Boss
     bool onTheScreen;		    // Says if the Boss already jumped on the screen True/False
     int bossDamage;             // Damage that boss gives the swallow
     int animationFrame;         // Tells which frame Boss should render
+    RANDOM random;              // Random stream of the boss
 
 } Boss;
 
-typedef struct{                 // Sturture of single players ranking
+typedef struct{                 // Sturture of single players ranking, also a record of the ranking file
 
-    int index;                  // Number of which one the person is in the ranking
-    char nick[180];             // Name of the person
+    char nick[RANKING_NICK];    // Name of the person
     int points;                 // How many points this player had at maksimum
     float timeUsed;             // How many time did it take to get that much points
     int lifeRemaining;          // How many life points the player had during the best playthrough
 
 }Ranking;
 
+typedef struct {                // Header of a ranking file, followed by the records
+
+    char magic[4];              // RANKING_MAGIC
+    uint32_t version;           // RANKING_VERSION
+    uint32_t count;             // Number of records
+    uint32_t recordSize;        // sizeof(Ranking) of the program that wrote it
+
+} RANKING_HEADER;
+
+typedef struct {                // Ranking file of a level mapped into memory (read only)
+
+    void* memory;               // Mapped file (NULL if the level has no ranking yet)
+    size_t size;                // Size of the file
+    int count;                  // Number of records
+    Ranking* records;           // Records in the order they were added
+
+} RANKING_MAP;
+
+typedef struct SKIP_NODE {      // Record in the skip list of the ranking, every level links to the next record with at least that many levels
+
+    uint32_t record;            // Number of the record
+    int height;                 // Number of levels
+    struct {
+        struct SKIP_NODE* next; // Next node on this level (NULL at the end)
+        int width;              // Records between this node and the next one on this level, the next one included
+    } link[];
+
+} SKIP_NODE;
+
+typedef struct RANKING_TABLE {  // Ranking of a level kept in memory, loaded once per process and saved only when it changes
+
+    char level[50];             // Name of the level
+    Ranking* records;           // Records in the order they were added
+    SKIP_NODE** nodes;          // Skip list node of every record
+    int count;                  // Number of records
+    int capacity;               // Number of records that fit in the arrays
+    int* hash;                  // Records by the hash of their nick (open addressing, -1 - empty slot)
+    int hashSize;               // Slots of the hash (power of two)
+    SKIP_NODE* head;            // Start of the skip list, records are sorted from the best score
+    RANDOM random;              // Levels of new nodes
+    bool loaded;                // False until the ranking is read for the first time
+    ino_t rankInode;            // Ranking file that was read (another one means the journal was compacted by some game)
+    struct timespec rankTime;   // Time the ranking file that was read was changed
+    long journalRead;           // Bytes of the journal already put into the ranking
+    int journaled;              // Scores in the journal that arent in the ranking file yet
+    struct RANKING_TABLE* next; // Ranking of the next level in the cache
+
+} RANKING_TABLE;
+
+typedef struct {                // Time spent in every part of the game, measured when the game is played or benchmarked
+
+    long long ns[PROFILE_PARTS];// Nanoseconds spent in every part (PROFILE_*)
+    long samples[PROFILE_PARTS];// Number of measurements of every part
+    long long worst[PROFILE_PARTS];// The longest measurement of every part
+    unsigned histogram[PROFILE_PARTS][PROFILE_BUCKETS];// Number of measurements in every time range, for percentiles
+    long ticks;                 // Simulated ticks
+
+} PROFILE;
+
+typedef struct {                // Single frame of the trace
+
+    long long time;             // Nanoseconds from the start of the trace to the end of the frame
+    long tick;                  // Ticks of the game simulated till the end of the frame
+    int ticks;                  // Ticks simulated in this frame
+    long long ns[PROFILE_PARTS];// Nanoseconds spent in every part of the frame (PROFILE_*)
+    int hunters;                // Hunters that already joined the game
+    int stars;                  // Stars in the game
+    bool boss;                  // Boss is on the screen
+    long starTests;             // Stars tested for a collision in this frame
+    long hunterTests;           // Hunters tested for a collision in this frame
+    int hp;                     // Health of the swallow
+    int wallet;                 // Gained stars
+
+} TRACE_RECORD;
+
+typedef struct {                // Timeline of the frames written to a Chrome trace (.json) or CSV file by its own thread
+
+    FILE* file;                 // Trace file
+    bool json;                  // Chrome trace_event JSON (false - CSV)
+    bool written;               // Some record is already in the file (JSON needs commas between records)
+    long long start;            // Time the trace was opened
+    PROFILE profile;            // Profile of the game that isnt measured otherwise
+    long long last[PROFILE_PARTS];// Profile at the end of the last frame
+    long lastTicks;             // Ticks at the end of the last frame
+    long lastTests[2];          // Collision tests of stars and hunters at the end of the last frame
+    TRACE_RECORD* buffers[2];   // One buffer is filled by the game while the writer writes the other one
+    int filling;                // Buffer filled by the game
+    int count;                  // Records in the filled buffer
+    int pending;                // Records waiting for the writer in the other buffer (0 - the writer is free)
+    long dropped;               // Records lost because the writer was still busy with the other buffer
+    bool closing;               // The writer ends after the last pending records
+    pthread_t writer;           // Thread that formats and writes the records
+    pthread_mutex_t lock;       // Guards filling, pending and closing
+    pthread_cond_t wake;        // Signals new pending records or a free writer
+
+} TRACE;
+
+typedef struct {                // Live counters of the game published in shared memory for pp1-top
+
+    TELEMETRY* shared;          // Mapped segment
+    char name[32];              // Name of the segment
+    TELEMETRY_DATA data;        // Counters kept by the game, the whole copy goes to the segment after every frame
+    long lastTests[2];          // Collision tests of stars and hunters already counted in this round
+
+} TELEMETRY_FEED;
+
+typedef struct {                // Structure of a single game session, everything the simulation needs
+
+    CONFIG_FILE* config;        // Configuration of the played level
+    Swallow* swallow;           // The player
+    Stars* stars;               // All stars
+    Hunters* hunters;           // All hunters
+    Boss* boss;                 // The Boss
+    SafeZone* safeZone;         // Safe zone in the middle of the screen
+    TAXI* taxi;                 // Friendly albatros taxi
+    float timer;                // Time left to the end of the game
+    long loopAllocations;       // Heap allocations made by the game code in the game loop (counted with DEBUG_ALLOCATIONS)
+    PROFILE* profile;           // Time of every part of a tick (NULL - nothing is measured)
+    TRACE* trace;               // Timeline of the frames (NULL - no trace)
+    TELEMETRY_FEED* telemetry;  // Live counters in shared memory (NULL - not published)
+
+} GAME;
+
+typedef struct {                // Windows used by the ncurses render backend
+
+    WIN* playWin;               // Window with the game
+    WIN* statusWin;             // Window with gained stars and controls
+    WIN* lifeWin;               // Window with health points and time
+    WIN* rankingWin;            // Window with the ranking of the level
+    long frameBytes;            // Bytes sent to the terminal by the last frame
+    long long totalBytes;       // Bytes sent to the terminal by every frame of the game
+    long frames;                // Number of frames sent to the terminal
+    bool showProfile;           // Timings of the frame are shown instead of the ranking
+    CONFIG_FILE* config;        // Config of the level the windows were made for
+    char* level;                // Level and player shown in the ranking window (NULL - no ranking)
+    char* playerName;
+
+} VIEW;
+
+int drawCounters = -1;          // I/O counters of the thread that draws (/proc/thread-self/io, Linux only), -1 - not available
+
+
+// Returns bytes the drawing thread passed to write() so far (wchar), 0 if the system doesn't count them.
+// It counts every write() of the thread, not only the terminal; while doupdate() runs only ncurses writes from it.
+long long TerminalBytes()
+{
+    char counters[512];
+    ssize_t length = drawCounters < 0 ? -1 : pread(drawCounters, counters, sizeof(counters) - 1, 0);
+    if (length <= 0)
+        return 0;
+    counters[length] = '\0';
+
+    char* written = strstr(counters, "wchar:");
+    return written ? atoll(written + strlen("wchar:")) : 0;
+}
+
+typedef struct RENDERER {       // Render backend, simulation never calls it directly
+
+    void* data;                                             // Backend specific state (VIEW for ncurses)
+    int (*ReadInput)(struct RENDERER* renderer);            // Returns players key or ERR if there is none
+    void (*DrawFrame)(struct RENDERER* renderer, GAME* game);// Shows the state of the game after a tick
+    bool realTime;                                          // Ticks follow the clock (false - as fast as possible)
+
+} RENDERER;
+
+typedef struct {                // Header of a replay file, followed by the config and one byte per tick
+
+    char magic[4];              // REPLAY_MAGIC
+    uint32_t version;           // REPLAY_VERSION
+    char level[50];             // Name of the level
+    char player[100];           // Nick of the player
+    int32_t seed;               // Seed of the session (the same as in the config)
+    uint32_t configSize;        // Size of the CONFIG_FILE that follows
+
+} REPLAY_HEADER;
+
+typedef struct {                // Keys of a session, written to a replay file or read back from it
+
+    FILE* file;                 // Open replay file (NULL - session isnt recorded)
+    bool playing;               // Keys come from the file instead of the player
+    long ticks;                 // Ticks written or read so far
+
+} REPLAY;
+
+typedef struct {                // Memory for the game, objects are placed one after another and never freed one by one
+
+    char* memory;               // Start of the memory
+    size_t size;                // Size of the memory
+    size_t used;                // Bytes already given away
+
+} ARENA;
+
+
+// Returns arena with memory for size bytes
+ARENA InitArena(size_t size)
+{
+    ARENA arena;
+    arena.memory = (char*)malloc(size);
+    arena.size = size;
+    arena.used = 0;
+
+    if (!arena.memory)
+    {
+        fprintf(stderr, "Can't allocate %zu bytes for the game.\n", size);
+        exit(1);
+    }
+
+    return arena;
+}
+
+
+// Returns next free part of the arena, there is no heap allocation
+void* ArenaAlloc(ARENA* arena, size_t size)
+{
+    if (arena->used + ARENA_SIZE(size) > arena->size)
+    {
+        fprintf(stderr, "The game arena is too small (%zu of %zu bytes used).\n", arena->used, arena->size);
+        exit(1);
+    }
+
+    void* memory = arena->memory + arena->used;
+    arena->used += ARENA_SIZE(size);
+    return memory;
+}
+
+
+// Free memory of the arena
+void FreeArena(ARENA* arena)
+{
+    free(arena->memory);
+    arena->memory = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
+
+
+// Returns time of the monotonic clock in nanoseconds
+long long MonotonicNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+
+const char* profileParts[PROFILE_PARTS] = { "input", "swallow", "stars", "boss", "taxi", "hunters", "clear", "draw", "hud", "refresh" };
+
+
+// Returns histogram bucket of the time, every power of two is split into PROFILE_STEPS buckets
+static inline int ProfileBucket(long long ns)
+{
+    if (ns < PROFILE_STEPS)
+        return ns < 0 ? 0 : ns;
+
+    int power = 63 - __builtin_clzll(ns);
+    int step = (ns >> (power - 2)) & (PROFILE_STEPS - 1);
+    return (power - 1) * PROFILE_STEPS + step;
+}
+
+
+// Adds the time since mark to the part of the profile and moves the mark to now, does nothing if the game isnt measured
+void ProfileMark(PROFILE* profile, int part, long long* mark)
+{
+    if (!profile)
+        return;
+
+    long long now = MonotonicNs();
+    long long ns = now - *mark;
+    profile->ns[part] += ns;
+    profile->samples[part]++;
+    profile->histogram[part][ProfileBucket(ns)]++;
+    if (ns > profile->worst[part])
+        profile->worst[part] = ns;
+    *mark = now;
+}
+
+
+// Returns time that fraction of the measurements of the part didnt exceed (the end of its histogram bucket)
+long long ProfilePercentile(PROFILE* profile, int part, double fraction)
+{
+    long target = (long)ceil(profile->samples[part] * fraction);
+    long counted = 0;
+
+    for (int bucket = 0; bucket < PROFILE_BUCKETS; bucket++)
+    {
+        counted += profile->histogram[part][bucket];
+        if (counted < target || counted == 0)
+            continue;
+
+        if (bucket < PROFILE_STEPS)
+            return bucket;
+        int power = bucket / PROFILE_STEPS + 1;
+        long long end = ((long long)(PROFILE_STEPS + bucket % PROFILE_STEPS + 1) << (power - 2)) - 1;
+        return end < profile->worst[part] ? end : profile->worst[part];
+    }
+
+    return profile->worst[part];
+}
+
+
+// Returns next number of the splitmix64 sequence, used only to fill the state of the generator
+uint64_t SplitMix(uint64_t* x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+
+// Seeds the generator, the same seed and stream give always the same numbers
+void SeedRandom(RANDOM* random, int seed, int stream)
+{
+    uint64_t x = (uint64_t)(uint32_t)seed << 32 | (uint32_t)stream;
+    uint64_t first = SplitMix(&x);
+    uint64_t second = SplitMix(&x);
+
+    random->state[0] = (uint32_t)first;
+    random->state[1] = (uint32_t)(first >> 32);
+    random->state[2] = (uint32_t)second;
+    random->state[3] = (uint32_t)(second >> 32);
+    if (!(random->state[0] | random->state[1] | random->state[2] | random->state[3]))
+        random->state[0] = 1;
+}
+
+
+// Returns random number from 0 to 2^31 - 1 (like rand() of the libc, but the state belongs to the caller)
+static inline int Random(RANDOM* random)
+{
+    uint32_t* s = random->state;
+    uint32_t result = s[1] * 5;
+    result = ((result << 7) | (result >> 25)) * 9;
+    uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 11) | (s[3] >> 21);
+
+    return result >> 1;
+}
+
+
+// Marks columns from-to of the row as possibly changed
+void MarkDirty(FRAMEBUFFER* frame, int y, int from, int to)
+{
+    if (from < frame->dirtyFrom[y])
+        frame->dirtyFrom[y] = from;
+    if (to > frame->dirtyTo[y])
+        frame->dirtyTo[y] = to;
+}
+
+
+// Sets the color of the next drawn cells
+void SetPen(WIN* W, int color)
+{
+    W->pen = color;
+}
+
+
+// Draw a single character into the frame and remember the cell, so the next frame can erase only it
+void DrawCell(WIN* W, int y, int x, char ch)
+{
+    FRAMEBUFFER* frame = W->frame;
+
+    // nothing can be drawn outside of the window
+    if (y < 0 || y >= W->rows || x < 0 || x >= W->cols)
+        return;
+
+    frame->cells[y * W->cols + x] = (chtype)(unsigned char)ch | COLOR_PAIR(W->pen);
+    MarkDirty(frame, y, x, x);
+
+    if (frame->drawnCount < W->rows * W->cols)
+        frame->drawnCells[frame->drawnCount++] = y * W->cols + x;
+    else
+        frame->drawnOverflow = true;
+}
+
 
 // Predicts swallows path and tells boss how to move
 void UpdateBoss(Boss* boss, Swallow* swallow, CONFIG_FILE* config)
@@ -164,7 +749,7 @@ void UpdateBoss(Boss* boss, Swallow* swallow, CONFIG_FILE* config)
     // Resizing the boss and randomizing his speed to match the level
     boss->size = config->max_swallow_health - swallow->hp + 1;
     if (config->max_boss_speed > 1)
-        boss->speed = rand() % (config->max_boss_speed - 1) + 2;
+        boss->speed = Random(&boss->random) % (config->max_boss_speed - 1) + 2;
     else
         boss->speed = 1;
 
@@ -221,8 +806,8 @@ void UpdateBoss(Boss* boss, Swallow* swallow, CONFIG_FILE* config)
     else
     {
         // To unaible "teleportation" we need to change the position of the Boss
-        boss->x = config->cols * (rand() % 2);
-        boss->y = rand() % config->rows;
+        boss->x = config->cols * (Random(&boss->random) % 2);
+        boss->y = Random(&boss->random) % config->rows;
         UpdateBoss(boss, swallow, config);
     }
 
@@ -233,37 +818,37 @@ void UpdateBoss(Boss* boss, Swallow* swallow, CONFIG_FILE* config)
 // Draws The Boss
 void DrawBoss(Boss* boss)
 {
-    wattron(boss->playWin->window, COLOR_PAIR(boss->color));
+    SetPen(boss->playWin, boss->color);
 
     // Draw a square
-    mvwprintw(boss->playWin->window, boss->y, boss->x, " ");
-    mvwprintw(boss->playWin->window, boss->y-1, boss->x, " ");
+    DrawCell(boss->playWin, boss->y, boss->x, ' ');
+    DrawCell(boss->playWin, boss->y-1, boss->x, ' ');
 
     // Make a square width as size of a boss
     for (size_t i = 0; i <= boss->size; i++)
     {
-        mvwprintw(boss->playWin->window, boss->y, boss->x + i, " ");
-        mvwprintw(boss->playWin->window, boss->y, boss->x - i, " ");
-        mvwprintw(boss->playWin->window, boss->y - 1, boss->x + i, " ");
-        mvwprintw(boss->playWin->window, boss->y - 1, boss->x - i, " ");
+        DrawCell(boss->playWin, boss->y, boss->x + i, ' ');
+        DrawCell(boss->playWin, boss->y, boss->x - i, ' ');
+        DrawCell(boss->playWin, boss->y - 1, boss->x + i, ' ');
+        DrawCell(boss->playWin, boss->y - 1, boss->x - i, ' ');
     }
 
     // Draw bosses beak
     if (boss->dx > 0)
-        mvwprintw(boss->playWin->window, boss->y, boss->x + boss->size+1, ">");
+        DrawCell(boss->playWin, boss->y, boss->x + boss->size+1, '>');
     else
-        mvwprintw(boss->playWin->window, boss->y, boss->x - boss->size - 1, ">");
+        DrawCell(boss->playWin, boss->y, boss->x - boss->size - 1, '>');
 
     // Animate bosses wings
     if (boss->animationFrame == 0)
     {
-        mvwprintw(boss->playWin->window, boss->y + 1, boss->x, " ");
-        mvwprintw(boss->playWin->window, boss->y + 2, boss->x, " ");
+        DrawCell(boss->playWin, boss->y + 1, boss->x, ' ');
+        DrawCell(boss->playWin, boss->y + 2, boss->x, ' ');
     }
     else if (boss->animationFrame == 2)
     {
-        mvwprintw(boss->playWin->window, boss->y - 1, boss->x, " ");
-        mvwprintw(boss->playWin->window, boss->y - 2, boss->x, " ");
+        DrawCell(boss->playWin, boss->y - 1, boss->x, ' ');
+        DrawCell(boss->playWin, boss->y - 2, boss->x, ' ');
     }
 
     boss->animationFrame++;
@@ -276,8 +861,8 @@ void DrawBoss(Boss* boss)
 void SpawnBoss(Boss* boss, CONFIG_FILE* config, Swallow* swallow)
 {
     boss->playWin = swallow->playWin;
-    boss->x = config->cols*(rand() % 2);
-    boss->y = rand() % config->rows;
+    boss->x = config->cols*(Random(&boss->random) % 2);
+    boss->y = Random(&boss->random) % config->rows;
     boss->color = BOSS_COLOR;
 
     UpdateBoss(boss, swallow, config);
@@ -352,1300 +937,4331 @@ void BounceBossBack(Boss* boss, Swallow* swallow, CONFIG_FILE* config)
 }
 
 
-// Moves the boss by frame
-void MoveBoss(Boss* boss, Swallow* swallow, CONFIG_FILE* config, SafeZone* safeZone, float* timer)
+// Returns the first of steps (counting from 1) at which point (x, y) moving by (dx, dy) every step is not further than sqrt(range2) from (tx, ty), 0 if it never is
+int FirstContactStep(int x, int y, int dx, int dy, int steps, int tx, int ty, long long range2)
 {
-    // Checks if it is time for boss to enter the game
-    if (*timer > boss->enterTime)
-        return;
+    // Squared distance after k steps is a*k*k + 2*b*k + c, so the contact steps lie between the roots of the parabola
+    long long qx = x - tx;
+    long long qy = y - ty;
+    long long a = dx*dx + dy*dy;
+    long long b = qx*dx + qy*dy;
+    long long c = qx*qx + qy*qy - range2;
+
+    if (steps < 1)
+        return 0;
+    if (a == 0)
+        return c <= 0 ? 1 : 0;
+
+    long long delta = b*b - a*c;
+    if (delta < 0)
+        return 0;
+
+    double root = (-b - sqrt((double)delta)) / a;
+    if (root > steps)
+        return 0;
+
+    // sqrt isnt exact, so the steps around the first root are checked on integers
+    long long k = root < 1 ? 1 : (long long)ceil(root);
+    while (k > 1 && a*(k-1)*(k-1) + 2*b*(k-1) + c <= 0)
+        k--;
+    for (int tries = 0; tries < 3 && k <= steps; tries++, k++)
+        if (a*k*k + 2*b*k + c <= 0)
+            return k;
 
-    DrawBoss(boss);
+    return 0;
+}
 
-    // Moves boss step by step, we dont want the boss to fly through swallow without collision
-    for (int i = 0; i < boss->speed; i++)
-    {
-        // Moves the boss by the linear function
-        boss->x += boss->dx;
-        boss->y = (boss->a*boss->x) + boss->b;
 
-        // Tells if boss already entere the screen, later he will collide with frames of the window
-        if (!boss->onTheScreen)
-        {
-            if (boss->x <= config->cols - 2 && boss->x >= 1 && boss->y <= config->rows - 2 && boss->y >= 0)
-                boss->onTheScreen = true;
-            else
-                break;
-        }
+// Returns y of the path y=ax+b at x, computed the same way as the moves of the boss and hunters do it
+static inline int PathY(float a, float b, int x)
+{
+    return (a*x) + b;
+}
 
-        BounceBossBack(boss, swallow, config);
 
-        // Check collision if safe zone isnt active
-        if (!safeZone->active)
-            CheckBossCollision(swallow, boss, config, safeZone, timer);
-    }
+// Tells if object flying with the path y=ax+b is outside of the window at x and has to bounce
+static inline bool PathLeaves(float a, float b, int x, CONFIG_FILE* config)
+{
+    int y = PathY(a, b, x);
+    return x < 1 || x > config->cols - 2 || y < 0 || y > config->rows - 2;
 }
 
 
-// Gives to the hunters arguments the default values
-void SpawnHunter(Hunter* tempHunter, Swallow* swallow, CONFIG_FILE* config, float* timer)
+// Returns the first of steps at which object flying with the path y=ax+b bounces from the frame, steps + 1 if it stays inside
+int FirstBounceStep(int x, int dx, float a, float b, int steps, CONFIG_FILE* config)
 {
-    tempHunter->speed = rand() % config->max_hunters_speed + 1;
-    tempHunter->onTheScreen = false;
-    tempHunter->x = config->cols*(rand() % 2 );
-    tempHunter->y = rand()%config->rows;
-    tempHunter->huntersStage = 0;
-    tempHunter->size = rand()%config->max_hunters_size + 1;
-    tempHunter->hunterWaitTime = 0;
-    tempHunter->animationFrame = 0;
+    if (steps < 1 || PathLeaves(a, b, x + dx, config))
+        return 1;
 
-    // Calculates hunters positions and vectors with linear function leading to swallow
-    if (tempHunter->x < swallow->x)
-        tempHunter->dx = 1;
-    else
-        tempHunter->dx = -1;
+    // x and y change monotonically along the path, so once inside the window the object leaves it only once
+    int inside = 1;
+    int outside = steps + 1;
+    while (outside - inside > 1)
+    {
+        int middle = (inside + outside) / 2;
+        if (PathLeaves(a, b, x + middle*dx, config))
+            outside = middle;
+        else
+            inside = middle;
+    }
 
-    if (tempHunter->x - swallow->x != 0)
-        tempHunter->a = (float)(tempHunter->y - swallow->y) / (float)(tempHunter->x - swallow->x);
-    else
-        tempHunter->a = 0;
+    return outside;
+}
 
-    tempHunter->b = swallow->y - (tempHunter->a * swallow->x);
 
-    if (*timer == 0)
-        tempHunter->boundsCounter = 0;
-    else
-        tempHunter->boundsCounter = (int)(config->max_hunters_bounds *  (config->start_time - *timer) / config->start_time + 1);
+// Returns the first of steps at which object flying with the path y=ax+b is not further than sqrt(range2) from (tx, ty), 0 if it never is
+int FirstPathContact(int x, int dx, float a, float b, int steps, int tx, int ty, long long range2)
+{
+    // Only steps with x close enough to the target can be in range
+    int reach = (int)sqrt((double)range2) + 1;
+    int from = dx*(tx - x) - reach;
+    int to = dx*(tx - x) + reach;
+    if (from < 1)
+        from = 1;
+    if (to > steps)
+        to = steps;
+
+    for (int k = from; k <= to; k++)
+    {
+        long long px = x + k*dx;
+        long long py = PathY(a, b, px);
+        if ((px - tx)*(px - tx) + (py - ty)*(py - ty) <= range2)
+            return k;
+    }
 
+    return 0;
 }
 
 
-// Gives configuration info from file in address as the CONFIG_FILE structure
-CONFIG_FILE* getConfigInfo(char* adress)
+// Moves the boss by one step of its path, returns false if the boss is still outside of the window
+bool BossStep(Boss* boss, Swallow* swallow, CONFIG_FILE* config, SafeZone* safeZone, float* timer)
 {
-    FILE* ofile;
-    CONFIG_FILE* cfile = (CONFIG_FILE*)malloc(sizeof(CONFIG_FILE));
-    char output[100];
-
-    ofile = fopen(adress, "r");
+    // Moves the boss by the linear function
+    boss->x += boss->dx;
+    boss->y = (boss->a*boss->x) + boss->b;
 
-    // Cheks if the file exist
-    if (!ofile)
+    // Tells if boss already entere the screen, later he will collide with frames of the window
+    if (!boss->onTheScreen)
     {
-        printf("The .conf file can't be found. Please add configuration file to play a game.");
-        exit(1);
+        if (boss->x <= config->cols - 2 && boss->x >= 1 && boss->y <= config->rows - 2 && boss->y >= 0)
+            boss->onTheScreen = true;
+        else
+            return false;
     }
 
-    // Skans arguments from file to the CONFIG_FILE structure
-    fscanf(
-        ofile, 
-        "start time = %f\n"
-        "seed = %i\n"
-        "window rows = %d\n"
-        "window cols = %d\n"
-        "max stars count = %d\n"
-        "max stars speed = %d\n"
-        "stars scoring weight = %d\n"
-        "max hunters size = %d\n"
-        "max hunters count = %d\n"
-        "max hunters speed = %d\n"
-        "max hunters bounds = %d\n"
-        "max swallow health = %d\n"
-        "hunter attack after time = %d\n"
-        "albatros taxi speed = %d\n"
-        "max boss speed = %d\n"
-        "boss enter part = %d\n"
-        "boss damage = %d",
-        &cfile->start_time, 
-        &cfile->seed,
-        &cfile->rows,
-        &cfile->cols,
-        &cfile->max_stars_count, 
-        &cfile->max_stars_speed,
-        &cfile->stars_scoring_weight,
-        &cfile->max_hunters_size,
-        &cfile->max_hunters_count,
-        &cfile->max_hunters_speed, 
-        &cfile->max_hunters_bounds, 
-        &cfile->max_swallow_health,
-        &cfile->hunter_attack_after_time,
-        &cfile->albatros_taxi_speed,
-        &cfile->max_boss_speed,
-        &cfile->boss_enter_part,                                
-        &cfile->boss_damage);
-    fclose(ofile);
+    BounceBossBack(boss, swallow, config);
 
-    return cfile;
+    // Check collision if safe zone isnt active
+    if (!safeZone->active)
+        CheckBossCollision(swallow, boss, config, safeZone, timer);
 
+    return true;
 }
 
 
-// Cheks if stars collide with swallow
-void CheckStarsCollision(Swallow* swallow, Star* star, CONFIG_FILE* config)
+// Moves the boss by frame
+void MoveBoss(Boss* boss, Swallow* swallow, CONFIG_FILE* config, SafeZone* safeZone, float* timer)
 {
-    float dx = star->x - swallow->x;
-    float dy = star->y - swallow->y;
+    // Checks if it is time for boss to enter the game
+    if (*timer > boss->enterTime)
+        return;
 
-    // Cheks if the distance between star and swallow if lower than acceptable
-    if((dx*dx+dy*dy) <= swallow->hp*swallow->hp)
+    // The boss cant fly through swallow without collision, but steps where it neither bounces nor hits are skipped at once
+    int step = 0;
+    while (step < boss->speed)
     {
-        // Respawn the star to the top
-        star->y = -10;
-        star->x = rand()%(config->cols-1) +1;
-        swallow->wallet +=star->stars_scoring_weight;
+        int steps = boss->speed - step;
+        int event = 1;
+        if (boss->onTheScreen)
+        {
+            event = FirstBounceStep(boss->x, boss->dx, boss->a, boss->b, steps, config);
+
+            long long range = boss->size + swallow->hp;
+            int contact = 0;
+            if (!safeZone->active)
+                contact = FirstPathContact(boss->x, boss->dx, boss->a, boss->b, event - 1, swallow->x, swallow->y, range*range);
+            if (contact)
+                event = contact;
+        }
+
+        // Nothing happens till the end of the frame
+        if (event > steps)
+        {
+            boss->x += steps*boss->dx;
+            boss->y = (boss->a*boss->x) + boss->b;
+            break;
+        }
+
+        boss->x += (event - 1)*boss->dx;
+        step += event;
+        if (!BossStep(boss, swallow, config, safeZone, timer))
+            break;
     }
 }
 
 
-// Cheks if hunter collide with swallow
-void CheckHuntersCollision(Swallow* swallow, Hunter* hunter, CONFIG_FILE* config, SafeZone* safeZone, float* timer)
+// Returns the width of grid cells, hunter can see the swallow from 2 * (hunters size + swallows health).
+// It is rounded up to a power of two, so finding the cell of an object needs no division.
+int GridCellSize(CONFIG_FILE* config)
 {
-    float dx = hunter->x-swallow->x;
-    float dy = hunter->y-swallow->y;
-    float minimum_distance = hunter->size + swallow->hp - 2;
-    float second_minimum_distance = hunter->size + config->max_swallow_health;
-    float distance = dx*dx + dy*dy;
+    int reach = 2 * (config->max_hunters_size + config->max_swallow_health);
+    int cellSize = 1;
 
-    if(safeZone->active)// If the zone is active, cheks collision with it
-    {
-        dx = hunter->x - config->cols / 2;
-        dy = hunter->y - config->rows / 2;
-        distance = dx * dx + dy * dy;
-        if (distance <= 4 * safeZone->range * safeZone->range)// Checks if the distance is samaler that acceptable for collision with safezone
-            SpawnHunter(hunter, swallow, config, timer);
-    }
-    else if(distance <= (minimum_distance * minimum_distance))// Checks if the distance is samaler that acceptable for collision with swallow
-    {
-        // Gives damage to swallow and makes boss to default
-        SpawnHunter(hunter, swallow, config, timer);
-        swallow->hp -= 1;
-    }
-    else if (distance <= 4*(second_minimum_distance * second_minimum_distance) && hunter->huntersStage == 0)// Checks if the distance is samaler that acceptable for swallow detection
-    {
-        // Starts the following procedure
-        hunter->huntersStage = 1;
-        hunter->hunterWaitTime = *timer;
-    }
+    while (cellSize < reach)
+        cellSize *= 2;
+
+    return cellSize;
 }
 
 
-// Cheks if swallow collide with hunters or stars
-void CheckSwallowsCollision(Swallow* swallow, Star** stars, Hunter** hunters, CONFIG_FILE* config, SafeZone* safeZone, float* timer)
+// Returns bytes of the arena needed by a batch of count objects
+size_t BatchArenaSize(int count)
 {
-    // In safe zone collision doesnt work
-    if (safeZone->active)
-        return;
+    return ARENA_SIZE(sizeof(BATCH)) + 2 * ARENA_SIZE(count * sizeof(int)) + 2 * ARENA_SIZE(count * sizeof(float)) +
+        2 * ARENA_SIZE(MASK_WORDS(count) * sizeof(unsigned));
+}
 
-    // Collision with every star
-    for (int i = 0; i < config->max_stars_count; i++)
-    {
-        CheckStarsCollision(swallow, stars[i], config);
-    }
-    
-    // Collision with every hunter
-    for (int i = 0; i < config->max_hunters_count; i++)
-    {
-        if (*timer  >= i * config->start_time / config->max_hunters_count)
-            continue;
-        CheckHuntersCollision(swallow, hunters[i], config, safeZone, timer);
-    }
-    
+
+// Returns empty batch for count objects
+BATCH* InitBatch(ARENA* arena, int count)
+{
+    BATCH* batch = (BATCH*)ArenaAlloc(arena, sizeof(BATCH));
+
+    batch->count = 0;
+    batch->x = (int*)ArenaAlloc(arena, count * sizeof(int));
+    batch->y = (int*)ArenaAlloc(arena, count * sizeof(int));
+    batch->hitRange = (float*)ArenaAlloc(arena, count * sizeof(float));
+    batch->seeRange = (float*)ArenaAlloc(arena, count * sizeof(float));
+    batch->hit = (unsigned*)ArenaAlloc(arena, MASK_WORDS(count) * sizeof(unsigned));
+    batch->see = (unsigned*)ArenaAlloc(arena, MASK_WORDS(count) * sizeof(unsigned));
+
+    return batch;
 }
 
 
-// Sets safe zones args as we call
-void SetSafeZone(SafeZone* zone, Swallow* swallow, bool active, CONFIG_FILE* config)
+// Returns how many arena bytes a grid for count objects needs
+size_t GridArenaSize(CONFIG_FILE* config, int count)
 {
-    zone->playWin = swallow->playWin;
-    zone->range = swallow->hp;
-    zone->x = config->cols/2;
-    zone->y = config->rows/2;
-    zone->active = active;
-    zone->color = SAFE_ZONE_COLOR;
+    int cellSize = GridCellSize(config);
+    int cells = (config->rows / cellSize + 1) * (config->cols / cellSize + 1);
+
+    return ARENA_SIZE(sizeof(GRID)) + ARENA_SIZE(cells * sizeof(int)) + 4 * ARENA_SIZE(count * sizeof(int)) +
+        BatchArenaSize(count);
 }
 
-// Gives to the taxies arguments the default values
-void SetTaxi(TAXI* taxi, Swallow* swallow, CONFIG_FILE* config)
+
+// Returns empty grid over the play area for count objects
+GRID* InitGrid(ARENA* arena, CONFIG_FILE* config, int count)
 {
-    taxi->playWin = swallow->playWin;
-    taxi->x = config->cols/2;
-    taxi->y = 1;
-    taxi->speed = config->albatros_taxi_speed;
-    taxi->dx = 0;
-    taxi->dy = 0;
+    GRID* grid = (GRID*)ArenaAlloc(arena, sizeof(GRID));
+
+    grid->cellSize = GridCellSize(config);
+    grid->cellShift = 0;
+    while ((1 << grid->cellShift) < grid->cellSize)
+        grid->cellShift++;
+    grid->rows = config->rows / grid->cellSize + 1;
+    grid->cols = config->cols / grid->cellSize + 1;
+    grid->head = (int*)ArenaAlloc(arena, grid->rows * grid->cols * sizeof(int));
+    grid->next = (int*)ArenaAlloc(arena, count * sizeof(int));
+    grid->prev = (int*)ArenaAlloc(arena, count * sizeof(int));
+    grid->cell = (int*)ArenaAlloc(arena, count * sizeof(int));
+    grid->found = (int*)ArenaAlloc(arena, count * sizeof(int));
+    grid->batch = InitBatch(arena, count);
+
+    for (int i = 0; i < grid->rows * grid->cols; i++)
+        grid->head[i] = -1;
+    for (int i = 0; i < count; i++)
+        grid->cell[i] = -1;
+    grid->tests = 0;
+
+    return grid;
+}
 
-    taxi->color = ALBATROS_TAXI_COLOR;
-    taxi->stage = 4;
+
+// Returns cell column of x (or row of y), objects outside of the play area belong to the nearest border cell
+static inline int GridIndex(int position, int cellShift, int cells)
+{
+    if (position < 0)
+        return 0;
+
+    int index = position >> cellShift;
+    return index < cells ? index : cells - 1;
 }
 
 
-// Moves swallow by frame
-void MoveSwallow(Swallow* swallow, Star** stars, Hunter** hunters, CONFIG_FILE* config, SafeZone* safeZone, float* timer)
+// Moves object to the cell of its new position, called every time a star or a hunter ends its move
+static inline void GridMove(GRID* grid, int id, int x, int y)
 {
-    // moves swallow step by step, we dont want the swallow to fly through smth without collision
-    for (int i = 0; i < swallow->speed; i++)
-    {
-        swallow->y += swallow->dy;
-        if (swallow->y > 0)
-            swallow->y %= config->rows;
-        else
-            swallow->y = config->rows;
+    int cell = GridIndex(y, grid->cellShift, grid->rows) * grid->cols + GridIndex(x, grid->cellShift, grid->cols);
 
-        swallow->x += swallow->dx;
-        if (swallow->x > 0)
-            swallow->x %= config->cols;
+    if (grid->cell[id] == cell)
+        return;
+
+    // take the object out of its old cell
+    if (grid->cell[id] >= 0)
+    {
+        if (grid->prev[id] >= 0)
+            grid->next[grid->prev[id]] = grid->next[id];
         else
-            swallow->x = config->cols;
+            grid->head[grid->cell[id]] = grid->next[id];
 
-        CheckSwallowsCollision(swallow, stars, hunters, config, safeZone, timer);
+        if (grid->next[id] >= 0)
+            grid->prev[grid->next[id]] = grid->prev[id];
+    }
+
+    // put it at the start of the new one
+    grid->cell[id] = cell;
+    grid->prev[id] = -1;
+    grid->next[id] = grid->head[cell];
+    if (grid->head[cell] >= 0)
+        grid->prev[grid->head[cell]] = id;
+    grid->head[cell] = id;
+}
+
+
+// Finds objects from cells that can be inside the box from (fromX, fromY) to (toX, toY), returns their number
+int GridQuery(GRID* grid, int fromX, int fromY, int toX, int toY)
+{
+    int fromCol = GridIndex(fromX, grid->cellShift, grid->cols);
+    int toCol = GridIndex(toX, grid->cellShift, grid->cols);
+    int fromRow = GridIndex(fromY, grid->cellShift, grid->rows);
+    int toRow = GridIndex(toY, grid->cellShift, grid->rows);
+    int count = 0;
+
+    for (int row = fromRow; row <= toRow; row++)
+        for (int col = fromCol; col <= toCol; col++)
+            for (int id = grid->head[row * grid->cols + col]; id >= 0; id = grid->next[id])
+                grid->found[count++] = id;
+
+    grid->tests += count;
+    return count;
+}
+
+
+// Sorts the first count found objects by index (there are only few of them), so they are checked in the same order as without the grid
+void SortFound(GRID* grid, int count)
+{
+    for (int i = 1; i < count; i++)
+    {
+        int id = grid->found[i];
+        int j = i - 1;
+        for (; j >= 0 && grid->found[j] > id; j--)
+            grid->found[j + 1] = grid->found[j];
+        grid->found[j + 1] = id;
+    }
+}
+
+// Tests gathered objects from index from against point (px, py) one by one
+void ProximityRest(BATCH* batch, int from, int px, int py)
+{
+    for (int k = from; k < batch->count; k++)
+    {
+        float dx = batch->x[k] - px;
+        float dy = batch->y[k] - py;
+        float distance = dx*dx + dy*dy;
+
+        if (distance <= batch->hitRange[k])
+            batch->hit[k / 32] |= 1u << (k % 32);
+        if (distance <= batch->seeRange[k])
+            batch->see[k / 32] |= 1u << (k % 32);
+    }
+}
+
+
+// Tests every gathered object against point (px, py), without SIMD
+void ProximityScalar(BATCH* batch, int px, int py)
+{
+    memset(batch->hit, 0, MASK_WORDS(batch->count) * sizeof(unsigned));
+    memset(batch->see, 0, MASK_WORDS(batch->count) * sizeof(unsigned));
+
+    ProximityRest(batch, 0, px, py);
+}
+
+
+#if defined(__x86_64__) || defined(__i386__)
+// Tests every gathered object against point (px, py), four objects at once with SSE2
+__attribute__((target("sse2")))
+void ProximitySse2(BATCH* batch, int px, int py)
+{
+    memset(batch->hit, 0, MASK_WORDS(batch->count) * sizeof(unsigned));
+    memset(batch->see, 0, MASK_WORDS(batch->count) * sizeof(unsigned));
+
+    // Same float operations as the scalar test, so the results are equal
+    __m128i x0 = _mm_set1_epi32(px);
+    __m128i y0 = _mm_set1_epi32(py);
+    int k = 0;
+    for (; k + 4 <= batch->count; k += 4)
+    {
+        __m128 dx = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_loadu_si128((__m128i*)(batch->x + k)), x0));
+        __m128 dy = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_loadu_si128((__m128i*)(batch->y + k)), y0));
+        __m128 distance = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+
+        unsigned hit = _mm_movemask_ps(_mm_cmple_ps(distance, _mm_loadu_ps(batch->hitRange + k)));
+        unsigned see = _mm_movemask_ps(_mm_cmple_ps(distance, _mm_loadu_ps(batch->seeRange + k)));
+        batch->hit[k / 32] |= hit << (k % 32);
+        batch->see[k / 32] |= see << (k % 32);
+    }
+
+    ProximityRest(batch, k, px, py);
+}
+
+
+// Tests every gathered object against point (px, py), eight objects at once with AVX2
+__attribute__((target("avx2")))
+void ProximityAvx2(BATCH* batch, int px, int py)
+{
+    memset(batch->hit, 0, MASK_WORDS(batch->count) * sizeof(unsigned));
+    memset(batch->see, 0, MASK_WORDS(batch->count) * sizeof(unsigned));
+
+    __m256i x0 = _mm256_set1_epi32(px);
+    __m256i y0 = _mm256_set1_epi32(py);
+    int k = 0;
+    for (; k + 8 <= batch->count; k += 8)
+    {
+        __m256 dx = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_loadu_si256((__m256i*)(batch->x + k)), x0));
+        __m256 dy = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_loadu_si256((__m256i*)(batch->y + k)), y0));
+        __m256 distance = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+
+        unsigned hit = _mm256_movemask_ps(_mm256_cmp_ps(distance, _mm256_loadu_ps(batch->hitRange + k), _CMP_LE_OQ));
+        unsigned see = _mm256_movemask_ps(_mm256_cmp_ps(distance, _mm256_loadu_ps(batch->seeRange + k), _CMP_LE_OQ));
+        batch->hit[k / 32] |= hit << (k % 32);
+        batch->see[k / 32] |= see << (k % 32);
+    }
+
+    // Clears upper halves of the registers, scalar code after dirty AVX registers is very slow
+    _mm256_zeroupper();
+    ProximityRest(batch, k, px, py);
+}
+#endif
+
+
+typedef void (*PROXIMITY_KERNEL)(BATCH* batch, int px, int py);  // Sets hit and see bits of every gathered object
+
+PROXIMITY_KERNEL proximityKernel = NULL;    // Kernel chosen for this processor
+
+
+// Returns the fastest proximity kernel this processor can run
+PROXIMITY_KERNEL ChooseProximityKernel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return ProximityAvx2;
+    if (__builtin_cpu_supports("sse2"))
+        return ProximitySse2;
+#endif
+    return ProximityScalar;
+}
+
+
+// Tests every gathered object against point (px, py) with the kernel chosen on the first call
+void TestProximity(BATCH* batch, int px, int py)
+{
+    if (!proximityKernel)
+        proximityKernel = ChooseProximityKernel();
+
+    proximityKernel(batch, px, py);
+}
+
+
+// Keeps only the found objects that the last batch test marked (hit or see), sorted by index, returns their number
+int KeepMarked(GRID* grid)
+{
+    BATCH* batch = grid->batch;
+    int kept = 0;
+
+    for (int word = 0; word < MASK_WORDS(batch->count); word++)
+        for (unsigned bits = batch->hit[word] | batch->see[word]; bits; bits &= bits - 1)
+            grid->found[kept++] = grid->found[word * 32 + __builtin_ctz(bits)];
+
+    SortFound(grid, kept);
+    return kept;
+}
+
+
+// Gives to the hunter with index i the default values
+void SpawnHunter(Hunters* hunters, int i, Swallow* swallow, CONFIG_FILE* config, float* timer)
+{
+    hunters->speed[i] = Random(&hunters->random) % config->max_hunters_speed + 1;
+    hunters->onTheScreen[i] = false;
+    hunters->x[i] = config->cols*(Random(&hunters->random) % 2 );
+    hunters->y[i] = Random(&hunters->random)%config->rows;
+    hunters->huntersStage[i] = 0;
+    hunters->size[i] = Random(&hunters->random)%config->max_hunters_size + 1;
+    hunters->hunterWaitTime[i] = 0;
+    hunters->animationFrame[i] = 0;
+
+    // Calculates hunters positions and vectors with linear function leading to swallow
+    if (hunters->x[i] < swallow->x)
+        hunters->dx[i] = 1;
+    else
+        hunters->dx[i] = -1;
+
+    if (hunters->x[i] - swallow->x != 0)
+        hunters->a[i] = (float)(hunters->y[i] - swallow->y) / (float)(hunters->x[i] - swallow->x);
+    else
+        hunters->a[i] = 0;
+
+    hunters->b[i] = swallow->y - (hunters->a[i] * swallow->x);
+
+    if (*timer == 0)
+        hunters->boundsCounter[i] = 0;
+    else
+        hunters->boundsCounter[i] = (int)(config->max_hunters_bounds *  (config->start_time - *timer) / config->start_time + 1);
+
+    GridMove(hunters->grid, i, hunters->x[i], hunters->y[i]);
+
+}
+
+
+// Keys of the level file with their defaults and ranges, ints used for modulo or division can't be 0
+const CONFIG_KEY configKeys[] = {
+    { "start time",                 offsetof(CONFIG_FILE, start_time),                  true,   30,     1,          86400 },
+    { "seed",                       offsetof(CONFIG_FILE, seed),                        false,  0,      INT_MIN,    INT_MAX },
+    { "window rows",                offsetof(CONFIG_FILE, rows),                        false,  40,     10,         500 },
+    { "window cols",                offsetof(CONFIG_FILE, cols),                        false,  120,    40,         1000 },
+    { "max stars count",            offsetof(CONFIG_FILE, max_stars_count),             false,  30,     0,          100000 },
+    { "max stars speed",            offsetof(CONFIG_FILE, max_stars_speed),             false,  1,      1,          100 },
+    { "stars scoring weight",       offsetof(CONFIG_FILE, stars_scoring_weight),        false,  1,      0,          1000 },
+    { "max hunters size",           offsetof(CONFIG_FILE, max_hunters_size),            false,  2,      1,          100 },
+    { "max hunters count",          offsetof(CONFIG_FILE, max_hunters_count),           false,  5,      1,          100000 },
+    { "max hunters speed",          offsetof(CONFIG_FILE, max_hunters_speed),           false,  2,      1,          100 },
+    { "max hunters bounds",         offsetof(CONFIG_FILE, max_hunters_bounds),          false,  3,      0,          1000 },
+    { "max swallow health",         offsetof(CONFIG_FILE, max_swallow_health),          false,  4,      1,          1000 },
+    { "hunter attack after time",   offsetof(CONFIG_FILE, hunter_attack_after_time),    false,  2,      0,          3600 },
+    { "albatros taxi speed",        offsetof(CONFIG_FILE, albatros_taxi_speed),         false,  3,      1,          100 },
+    { "max boss speed",             offsetof(CONFIG_FILE, max_boss_speed),              false,  3,      1,          100 },
+    { "boss enter part",            offsetof(CONFIG_FILE, boss_enter_part),             false,  100,    1,          1000 },
+    { "boss damage",                offsetof(CONFIG_FILE, boss_damage),                 false,  1,      0,          1000 },
+    { "tick rate",                  offsetof(CONFIG_FILE, tick_rate),                   false,  DEFAULT_TICK_RATE, 1, 1000 },
+};
+
+
+// Tells if the value is in the range of the key (NaN never is)
+bool ConfigValueInRange(const CONFIG_KEY* key, double value)
+{
+    return value >= key->min && value <= key->max;
+}
+
+
+// Returns the key with a value out of its range, NULL if the whole config is right. Configs read back from binary files are checked with it
+const CONFIG_KEY* ValidateConfig(const CONFIG_FILE* cfile)
+{
+    int keysCount = sizeof(configKeys) / sizeof(configKeys[0]);
+    for (int k = 0; k < keysCount; k++)
+    {
+        const char* field = (const char*)cfile + configKeys[k].offset;
+        double value = configKeys[k].isFloat ? *(const float*)field : *(const int*)field;
+        if (!ConfigValueInRange(&configKeys[k], value))
+            return &configKeys[k];
+    }
+
+    return NULL;
+}
+
+
+// Cuts white characters from both ends of the text
+char* Trim(char* text)
+{
+    while (*text == ' ' || *text == '\t')
+        text++;
+
+    char* end = text + strlen(text);
+    while (end > text && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r'))
+        end--;
+    *end = '\0';
+
+    return text;
+}
+
+
+// Puts the value of the key into the config, returns false if it isnt a decimal number or is out of the range
+bool SetConfigValue(CONFIG_FILE* cfile, const CONFIG_KEY* key, const char* text)
+{
+    // strtod also takes hex numbers, "inf" and "nan", they arent allowed in a level file
+    if (strspn(text, key->isFloat ? "+-0123456789.eE" : "+-0123456789") != strlen(text))
+        return false;
+
+    char* end;
+    double value = key->isFloat ? strtod(text, &end) : strtol(text, &end, 10);
+
+    if (end == text || *end != '\0' || !ConfigValueInRange(key, value))
+        return false;
+
+    if (key->isFloat)
+        *(float*)((char*)cfile + key->offset) = value;
+    else
+        *(int*)((char*)cfile + key->offset) = (int)value;
+    return true;
+}
+
+
+// Reads "key = value" lines of the level file in any order, "#" starts a comment. Missing keys get default values, returns false with the error for a wrong line
+bool ParseConfig(FILE* ofile, const char* adress, CONFIG_FILE* cfile, char* error, size_t errorSize)
+{
+    int keysCount = sizeof(configKeys) / sizeof(configKeys[0]);
+    for (int k = 0; k < keysCount; k++)
+    {
+        if (configKeys[k].isFloat)
+            *(float*)((char*)cfile + configKeys[k].offset) = configKeys[k].defaultValue;
+        else
+            *(int*)((char*)cfile + configKeys[k].offset) = (int)configKeys[k].defaultValue;
+    }
+
+    char line[300];
+    for (int number = 1; fgets(line, sizeof(line), ofile); number++)
+    {
+        char* comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+
+        char* text = Trim(line);
+        if (*text == '\0')
+            continue;
+
+        char* equals = strchr(text, '=');
+        if (!equals)
+        {
+            snprintf(error, errorSize, "%s:%d: expected \"key = value\"\n", adress, number);
+            return false;
+        }
+        *equals = '\0';
+        char* name = Trim(text);
+        char* value = Trim(equals + 1);
+
+        int k = 0;
+        while (k < keysCount && strcmp(configKeys[k].name, name) != 0)
+            k++;
+        if (k == keysCount)
+        {
+            snprintf(error, errorSize, "%s:%d: unknown key \"%s\"\n", adress, number, name);
+            return false;
+        }
+        if (!SetConfigValue(cfile, &configKeys[k], value))
+        {
+            snprintf(error, errorSize, "%s:%d: \"%s\" has to be a decimal number from %.0f to %.0f\n", adress, number, name, configKeys[k].min, configKeys[k].max);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Makes address of the compiled config in the cache (./.cache/levels_easy for ./levels/easy)
+void ConfigCacheAddress(char* cache, size_t size, const char* adress)
+{
+    if (strncmp(adress, "./", 2) == 0)
+        adress += 2;
+
+    int length = snprintf(cache, size, "./.cache/%s", adress);
+    for (char* c = cache + strlen("./.cache/"); c < cache + length && *c; c++)
+        if (*c == '/')
+            *c = '_';
+}
+
+
+// Reads the compiled config of the level file if it was made from the same version of the file, returns false if it wasnt or has a wrong value
+bool ReadConfigCache(const char* adress, struct stat* info, CONFIG_FILE* cfile)
+{
+    char cache[200];
+    ConfigCacheAddress(cache, sizeof(cache), adress);
+
+    FILE* f = fopen(cache, "rb");
+    if (!f)
+        return false;
+
+    CONFIG_CACHE_HEADER header;
+    bool read = fread(&header, sizeof(header), 1, f) == 1 &&
+        memcmp(header.magic, CONFIG_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == CONFIG_CACHE_VERSION && header.configSize == sizeof(CONFIG_FILE) &&
+        header.modified == (int64_t)info->st_mtim.tv_sec * 1000000000 + info->st_mtim.tv_nsec && header.size == info->st_size &&
+        fread(cfile, sizeof(CONFIG_FILE), 1, f) == 1 && ValidateConfig(cfile) == NULL;
+    fclose(f);
+
+    return read;
+}
+
+
+// Writes the compiled config of the level file to the cache, the old one is replaced only by a complete file
+void WriteConfigCache(const char* adress, struct stat* info, CONFIG_FILE* cfile)
+{
+    char cache[200], temporary[220];
+    ConfigCacheAddress(cache, sizeof(cache), adress);
+    snprintf(temporary, sizeof(temporary), "%s.%d", cache, (int)getpid());
+
+    mkdir("./.cache", 0755);
+    FILE* f = fopen(temporary, "wb");
+    if (!f)
+        return;
+
+    CONFIG_CACHE_HEADER header = { { 0 }, CONFIG_CACHE_VERSION, sizeof(CONFIG_FILE), (int64_t)info->st_mtim.tv_sec * 1000000000 + info->st_mtim.tv_nsec, info->st_size };
+    memcpy(header.magic, CONFIG_CACHE_MAGIC, sizeof(header.magic));
+    bool written = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(cfile, sizeof(CONFIG_FILE), 1, f) == 1;
+
+    if (fclose(f) != 0 || !written || rename(temporary, cache) != 0)
+        remove(temporary);
+}
+
+
+// Reads the level file in address to cfile, the compiled config from the cache is used if the file didnt change. Returns false with the error if it cant be read
+bool LoadConfig(char* adress, CONFIG_FILE* cfile, char* error, size_t errorSize)
+{
+    struct stat info;
+    FILE* ofile = fopen(adress, "r");
+
+    // Cheks if the file exist
+    if (!ofile || fstat(fileno(ofile), &info) != 0)
+    {
+        if (ofile)
+            fclose(ofile);
+        snprintf(error, errorSize, "The .conf file can't be found. Please add configuration file to play a game.");
+        return false;
+    }
+
+    bool loaded = true;
+    if (!ReadConfigCache(adress, &info, cfile))
+    {
+        loaded = ParseConfig(ofile, adress, cfile, error, errorSize);
+        if (loaded)
+            WriteConfigCache(adress, &info, cfile);
+    }
+    fclose(ofile);
+
+    return loaded;
+}
+
+
+// Gives configuration info from file in address as the CONFIG_FILE structure, ends the program if the file is wrong
+CONFIG_FILE* getConfigInfo(char* adress)
+{
+    CONFIG_FILE* cfile = (CONFIG_FILE*)malloc(sizeof(CONFIG_FILE));
+    char error[300];
+
+    if (!LoadConfig(adress, cfile, error, sizeof(error)))
+    {
+        printf("%s", error);
+        exit(1);
+    }
+
+    return cfile;
+}
+
+
+// Cheks if star with index i collides with swallow
+void CheckStarsCollision(Swallow* swallow, Stars* stars, int i, CONFIG_FILE* config)
+{
+    float dx = stars->x[i] - swallow->x;
+    float dy = stars->y[i] - swallow->y;
+
+    // Cheks if the distance between star and swallow if lower than acceptable
+    if((dx*dx+dy*dy) <= swallow->hp*swallow->hp)
+    {
+        // Respawn the star to the top
+        stars->y[i] = -10;
+        stars->x[i] = Random(&stars->random)%(config->cols-1) +1;
+        swallow->wallet +=stars->stars_scoring_weight;
+        GridMove(stars->grid, i, stars->x[i], stars->y[i]);
+    }
+}
+
+
+// Cheks if hunter with index i collides with swallow
+void CheckHuntersCollision(Swallow* swallow, Hunters* hunters, int i, CONFIG_FILE* config, SafeZone* safeZone, float* timer)
+{
+    float dx = hunters->x[i]-swallow->x;
+    float dy = hunters->y[i]-swallow->y;
+    float minimum_distance = hunters->size[i] + swallow->hp - 2;
+    float second_minimum_distance = hunters->size[i] + config->max_swallow_health;
+    float distance = dx*dx + dy*dy;
+
+    if(safeZone->active)// If the zone is active, cheks collision with it
+    {
+        dx = hunters->x[i] - config->cols / 2;
+        dy = hunters->y[i] - config->rows / 2;
+        distance = dx * dx + dy * dy;
+        if (distance <= 4 * safeZone->range * safeZone->range)// Checks if the distance is samaler that acceptable for collision with safezone
+            SpawnHunter(hunters, i, swallow, config, timer);
+    }
+    else if(distance <= (minimum_distance * minimum_distance))// Checks if the distance is samaler that acceptable for collision with swallow
+    {
+        // Gives damage to swallow and makes boss to default
+        SpawnHunter(hunters, i, swallow, config, timer);
+        swallow->hp -= 1;
+    }
+    else if (distance <= 4*(second_minimum_distance * second_minimum_distance) && hunters->huntersStage[i] == 0)// Checks if the distance is samaler that acceptable for swallow detection
+    {
+        // Starts the following procedure
+        hunters->huntersStage[i] = 1;
+        hunters->hunterWaitTime[i] = *timer;
+    }
+}
+
+
+// Cheks if swallow collide with hunters or stars, objects from the near cells of the grid are tested at once by the proximity kernel
+void CheckSwallowsCollision(Swallow* swallow, Stars* stars, Hunters* hunters, CONFIG_FILE* config, SafeZone* safeZone, float* timer)
+{
+    // In safe zone collision doesnt work
+    if (safeZone->active)
+        return;
+
+    // Stars from the near cells
+    GRID* grid = stars->grid;
+    BATCH* batch = grid->batch;
+    int range = abs(swallow->hp);
+    int count = GridQuery(grid, swallow->x - range, swallow->y - range, swallow->x + range, swallow->y + range);
+    for (int k = 0; k < count; k++)
+    {
+        int i = grid->found[k];
+        batch->x[k] = stars->x[i];
+        batch->y[k] = stars->y[i];
+        batch->hitRange[k] = swallow->hp*swallow->hp;
+        batch->seeRange[k] = -1;
+    }
+    batch->count = count;
+    TestProximity(batch, swallow->x, swallow->y);
+
+    // Collision with every star in range, in order of their indexes
+    int hits = KeepMarked(grid);
+    for (int k = 0; k < hits; k++)
+    {
+        CheckStarsCollision(swallow, stars, grid->found[k], config);
+    }
+
+    // Hunters from the near cells, a hit changes health and with it the hit range of the next hunters, so they are tested again
+    grid = hunters->grid;
+    batch = grid->batch;
+    int checked = -1;
+    bool again = true;
+    while (again)
+    {
+        again = false;
+
+        // Hunters see the swallow from further than they hit it (hit range grows only with negative health)
+        int reach = 2 * (config->max_hunters_size + config->max_swallow_health) + (swallow->hp < 0 ? -swallow->hp : 0);
+        count = GridQuery(grid, swallow->x - reach, swallow->y - reach, swallow->x + reach, swallow->y + reach);
+
+        // Only the hunters that already joined the game and werent checked yet are gathered
+        batch->count = 0;
+        for (int k = 0; k < count; k++)
+        {
+            int i = grid->found[k];
+            if (i <= checked || *timer  >= i * config->start_time / config->max_hunters_count)
+                continue;
+
+            float hitDistance = hunters->size[i] + swallow->hp - 2;
+            float seeDistance = hunters->size[i] + config->max_swallow_health;
+            grid->found[batch->count] = i;
+            batch->x[batch->count] = hunters->x[i];
+            batch->y[batch->count] = hunters->y[i];
+            batch->hitRange[batch->count] = hitDistance*hitDistance;
+            batch->seeRange[batch->count] = hunters->huntersStage[i] == 0 ? 4*(seeDistance*seeDistance) : -1;
+            batch->count++;
+        }
+        TestProximity(batch, swallow->x, swallow->y);
+
+        // Collision with every hunter in range, in order of their indexes
+        hits = KeepMarked(grid);
+        for (int k = 0; k < hits; k++)
+        {
+            int hp = swallow->hp;
+            CheckHuntersCollision(swallow, hunters, grid->found[k], config, safeZone, timer);
+
+            if (swallow->hp != hp)
+            {
+                checked = grid->found[k];
+                again = true;
+                break;
+            }
+        }
+    }
+}
+
+
+// Sets safe zones args as we call
+void SetSafeZone(SafeZone* zone, Swallow* swallow, bool active, CONFIG_FILE* config)
+{
+    zone->playWin = swallow->playWin;
+    zone->range = swallow->hp;
+    zone->x = config->cols/2;
+    zone->y = config->rows/2;
+    zone->active = active;
+    zone->color = SAFE_ZONE_COLOR;
+}
+
+// Gives to the taxies arguments the default values
+void SetTaxi(TAXI* taxi, Swallow* swallow, CONFIG_FILE* config)
+{
+    taxi->playWin = swallow->playWin;
+    taxi->x = config->cols/2;
+    taxi->y = 1;
+    taxi->speed = config->albatros_taxi_speed;
+    taxi->dx = 0;
+    taxi->dy = 0;
+
+    taxi->color = ALBATROS_TAXI_COLOR;
+    taxi->stage = 4;
+}
+
+
+// Returns how many steps coordinate v can move by d before it comes out on the other side of the window of size n
+int StraightSteps(int v, int d, int n)
+{
+    if (d > 0)
+        return v < n - 1 ? n - 1 - v : 0;
+    if (d < 0)
+        return v > 1 ? v - 1 : 0;
+
+    return (v > 0 && v < n) ? INT_MAX : 0;
+}
+
+
+// Returns the first of steps at which swallow flying straight touches a star or a hunter, 0 if it doesnt
+int FirstSwallowContact(Swallow* swallow, Stars* stars, Hunters* hunters, CONFIG_FILE* config, float* timer, int steps)
+{
+    int fromX = swallow->x + (swallow->dx < 0 ? steps*swallow->dx : 0);
+    int toX = swallow->x + (swallow->dx > 0 ? steps*swallow->dx : 0);
+    int fromY = swallow->y + (swallow->dy < 0 ? steps*swallow->dy : 0);
+    int toY = swallow->y + (swallow->dy > 0 ? steps*swallow->dy : 0);
+    int first = 0;
+
+    // Stars near the way of the swallow
+    GRID* grid = stars->grid;
+    int range = abs(swallow->hp);
+    int count = GridQuery(grid, fromX - range, fromY - range, toX + range, toY + range);
+    for (int k = 0; k < count; k++)
+    {
+        int i = grid->found[k];
+        int contact = FirstContactStep(swallow->x, swallow->y, swallow->dx, swallow->dy, steps, stars->x[i], stars->y[i], (long long)range*range);
+        if (contact)
+            first = steps = contact;
+    }
+
+    // Hunters near the way of the swallow, the ones that still look for it react already when they see it
+    int reach = 2 * (config->max_hunters_size + config->max_swallow_health) + (swallow->hp < 0 ? -swallow->hp : 0);
+    grid = hunters->grid;
+    count = GridQuery(grid, fromX - reach, fromY - reach, toX + reach, toY + reach);
+    for (int k = 0; k < count; k++)
+    {
+        int i = grid->found[k];
+        if (*timer  >= i * config->start_time / config->max_hunters_count)
+            continue;
+
+        long long hit = hunters->size[i] + swallow->hp - 2;
+        long long range2 = hit*hit;
+        if (hunters->huntersStage[i] == 0)
+        {
+            long long see = 2 * (hunters->size[i] + config->max_swallow_health);
+            if (see*see > range2)
+                range2 = see*see;
+        }
+
+        int contact = FirstContactStep(swallow->x, swallow->y, swallow->dx, swallow->dy, steps, hunters->x[i], hunters->y[i], range2);
+        if (contact)
+            first = steps = contact;
+    }
+
+    return first;
+}
+
+
+// Moves swallow by frame
+void MoveSwallow(Swallow* swallow, Stars* stars, Hunters* hunters, CONFIG_FILE* config, SafeZone* safeZone, float* timer)
+{
+    // swallow cant fly through smth without collision, collisions are checked only at steps where it touches something
+    int steps = swallow->speed;
+    while (steps > 0)
+    {
+        int straight = steps;
+        int straightX = StraightSteps(swallow->x, swallow->dx, config->cols);
+        int straightY = StraightSteps(swallow->y, swallow->dy, config->rows);
+        if (straightX < straight)
+            straight = straightX;
+        if (straightY < straight)
+            straight = straightY;
+
+        int event = 1;
+        if (straight > 0)
+        {
+            int contact = safeZone->active ? 0 : FirstSwallowContact(swallow, stars, hunters, config, timer, straight);
+            if (!contact)
+            {
+                swallow->x += straight*swallow->dx;
+                swallow->y += straight*swallow->dy;
+                steps -= straight;
+                continue;
+            }
+            event = contact;
+        }
+
+        // Flies straight till the step before the event, the event step comes out on the other side if needed
+        swallow->x += (event - 1)*swallow->dx;
+        swallow->y += (event - 1)*swallow->dy;
+        steps -= event;
+
+        swallow->y += swallow->dy;
+        if (swallow->y > 0)
+            swallow->y %= config->rows;
+        else
+            swallow->y = config->rows;
+
+        swallow->x += swallow->dx;
+        if (swallow->x > 0)
+            swallow->x %= config->cols;
+        else
+            swallow->x = config->cols;
+
+        CheckSwallowsCollision(swallow, stars, hunters, config, safeZone, timer);
     }
 }
 
 
 // Input controller that reacts with player moves
-void PlayerMovement(Swallow* swallow, int input, Star** stars, Hunter** hunters, CONFIG_FILE* config, float* timer, SafeZone* safeZone, TAXI* taxi)
+void PlayerMovement(Swallow* swallow, int input, Stars* stars, Hunters* hunters, CONFIG_FILE* config, float* timer, SafeZone* safeZone, TAXI* taxi)
+{
+    switch (input)
+    {
+    case 's':               // sets swallows direction to down
+        swallow->dx = 0;
+        swallow->dy = 1;
+        break;
+    
+    case 'w':               // sets swallows direction to up
+        swallow->dx = 0;
+        swallow->dy = -1;
+        break;
+
+    case 'd':               // sets swallows direction to right
+        swallow->dx = 1;
+        swallow->dy = 0;
+        break;
+
+    case 'a':               // sets swallows direction to left
+        swallow->dx = -1;
+        swallow->dy = 0;
+        break;
+
+    case 'o':               // makes swallow slower
+        if(swallow->speed > 1)
+            swallow->speed -= 1;
+        break;
+
+    case 'p':               // makes swallow faster
+        if(swallow->speed < 5)
+            swallow->speed = swallow->speed +1;
+        break;
+
+    case ' ':               // calls albatros taxi
+        if (taxi->stage >= 3)
+        {
+            SetTaxi(taxi, swallow, config);
+            taxi->stage = 0;
+        }
+        break;
+    
+    default:
+        break;
+    }
+    
+    MoveSwallow(swallow, stars, hunters, config, safeZone, timer);
+}
+
+
+// Draw Swallow shape
+void DrawSwallow(WIN* playWin, Swallow* swallow)
+{
+	SetPen(playWin, swallow->color);
+
+    // Draws exact frame. Depends of the size of the swallow
+    switch (swallow->animationFrame % 4)
+    {
+    case 0:
+        for (int i = 0; i < swallow->hp; i++)
+        {
+            if(swallow->y-i >=0 && swallow->x-(i+1)>=0)
+                DrawCell(playWin, swallow->y-i, swallow->x-(i+1), '\\');
+            if(swallow->y-i >=0 && swallow->x+i>=0)
+                DrawCell(playWin, swallow->y-i, swallow->x+i, '/');
+        }
+        break;
+    case 1:
+        for (int i = 0; i < swallow->hp; i++)
+        {
+            if(swallow->y >=0 && swallow->x-(i+1)-i>=0)
+                DrawCell(playWin, swallow->y, swallow->x-(i+1), '-');
+            if(swallow->y >=0 && swallow->x+i>=0)
+                DrawCell(playWin, swallow->y, swallow->x+i, '-');
+        }
+        break;
+    case 2:
+        for (int i = 0; i < swallow->hp; i++)
+        {
+            if(swallow->y+i >=0 && swallow->x-(i+1)>=0)
+                DrawCell(playWin, swallow->y+i, swallow->x-(i+1), '/');
+            if(swallow->y+i >=0 && swallow->x+i>=0)
+                DrawCell(playWin, swallow->y+i, swallow->x+i, '\\');
+        }
+        break;
+
+    case 3:
+        for (int i = 0; i < swallow->hp; i++)
+        {
+            if(swallow->y >=0 && swallow->x-(i+1)>=0)
+                DrawCell(playWin, swallow->y, swallow->x-(i+1), '-');
+            if(swallow->y >=0 && swallow->x+i>=0)
+                DrawCell(playWin, swallow->y, swallow->x+i, '-');
+        }
+        break;
+    
+    default:
+        break;
+    }
+
+    // Increase animation frame to "move" the swallow
+    swallow->animationFrame +=1;
+}
+
+
+// Bounce hunter with index i from the frame
+void BounceHunter(Hunters* hunters, int i, CONFIG_FILE* config)
+{
+    if (hunters->y[i] < 0)
+    {
+        hunters->y[i] = 0;
+        hunters->a[i] *= -1;
+        hunters->b[i] = hunters->y[i] - (hunters->a[i] * hunters->x[i]);
+        hunters->boundsCounter[i] -= 1;
+        hunters->huntersStage[i] = 0;
+    }
+    else if (hunters->y[i] > config->rows - 2)
+    {
+        hunters->y[i] = config->rows - 2;
+        hunters->a[i] *= -1;
+        hunters->b[i] = hunters->y[i] - (hunters->a[i] * hunters->x[i]);
+        hunters->boundsCounter[i] -= 1;
+        hunters->huntersStage[i] = 0;
+    }
+
+
+    if (hunters->x[i] < 1)
+    {
+        hunters->x[i] = 1;
+        hunters->a[i] *= -1;
+        hunters->b[i] = hunters->y[i] - (hunters->a[i] * hunters->x[i]);
+        hunters->dx[i] *= -1;
+        hunters->boundsCounter[i] -= 1;
+        hunters->huntersStage[i] = 0;
+    }
+    else if (hunters->x[i] > config->cols - 2)
+    {
+        hunters->x[i] = config->cols - 2;
+        hunters->a[i] *= -1;
+        hunters->b[i] = hunters->y[i] - (hunters->a[i] * hunters->x[i]);
+        hunters->dx[i] *= -1;
+        hunters->boundsCounter[i] -= 1;
+        hunters->huntersStage[i] = 0;
+    }
+}
+
+
+// Draw shape of hunter with index i
+void DrawHunter(WIN* playWin, Hunters* hunters, int i)
+{
+    int x = hunters->x[i];
+    int y = hunters->y[i];
+    int size = hunters->size[i];
+
+    SetPen(playWin, hunters->color);
+
+    // Write number of bounces above the hunter
+    char counter[2];
+    snprintf(counter, sizeof(counter), "%d", hunters->boundsCounter[i]);
+    DrawCell(playWin, y - 1, x, counter[0]);
+
+    // Draws exact frame. Depends of the size of the hunter.
+    switch (hunters->animationFrame[i] % 4)
+    {
+    case 0:
+        for (int j = 0; j < size; j++)
+        {
+            if (y - j >= 0 && x - (j + 1) >= 0)
+                DrawCell(playWin, y - j, x - (j + 1), '\\');
+            if (y - j >= 0 && x + j >= 0)
+                DrawCell(playWin, y - j, x + j, '/');
+        }
+        break;
+    case 1:
+        for (int j = 0; j < size; j++)
+        {
+            if (y >= 0 && x - (j + 1) - j >= 0)
+                DrawCell(playWin, y, x - (j + 1), '-');
+            if (y >= 0 && x + j >= 0)
+                DrawCell(playWin, y, x + j, '-');
+        }
+        break;
+    case 2:
+        for (int j = 0; j < size; j++)
+        {
+            if (y + j >= 0 && x - (j + 1) >= 0)
+                DrawCell(playWin, y + j, x - (j + 1), '/');
+            if (y + j >= 0 && x + j >= 0)
+                DrawCell(playWin, y + j, x + j, '\\');
+        }
+        break;
+
+    case 3:
+        for (int j = 0; j < size; j++)
+        {
+            if (y >= 0 && x - (j + 1) >= 0)
+                DrawCell(playWin, y, x - (j + 1), '-');
+            if (y >= 0 && x + j >= 0)
+                DrawCell(playWin, y, x + j, '-');
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    // Increase animation frame to "move" the hunter
+    hunters->animationFrame[i] += 1;
+}
+
+
+// Moves hunter with index i by one step of its path, returns false if the hunter is still outside of the window
+bool HunterStep(Hunters* hunters, int i, Swallow* swallow, CONFIG_FILE* config, SafeZone* safeZone, float* timer)
+{
+    hunters->x[i] += hunters->dx[i];
+    hunters->y[i] = (hunters->a[i]*hunters->x[i]) + hunters->b[i];
+
+    if (hunters->onTheScreen[i] == 0)
+    {
+        if (hunters->x[i] <= config->cols - 2 && hunters->x[i] >= 1 && hunters->y[i] <= config->rows - 2 && hunters->y[i] >= 0)
+            hunters->onTheScreen[i] = 1;
+        else
+            return false;
+    }
+
+    BounceHunter(hunters, i, config);
+
+    if (!safeZone->active)
+        CheckHuntersCollision(swallow, hunters, i, config, safeZone, timer);
+
+    return true;
+}
+
+
+// Moves hunter with index i by frame
+void MoveHunter(Hunters* hunters, int i, Swallow* swallow, CONFIG_FILE* config,SafeZone* safeZone, float* timer)
+{
+    // Cheks if can bounce
+    if (hunters->boundsCounter[i] <= 0)
+        SpawnHunter(hunters, i, swallow, config, timer);
+
+    // Moves hunter (depends of stage)
+    if (hunters->huntersStage[i] != 1)
+    {
+        // Fly with a path, steps where the hunter neither bounces nor meets the swallow are skipped at once
+        int step = 0;
+        while (step < hunters->speed[i])
+        {
+            int steps = hunters->speed[i] - step;
+            int event = 1;
+            if (hunters->onTheScreen[i])
+            {
+                event = FirstBounceStep(hunters->x[i], hunters->dx[i], hunters->a[i], hunters->b[i], steps, config);
+
+                // Hunter reacts when it hits the swallow or sees it while patroling
+                long long hit = hunters->size[i] + swallow->hp - 2;
+                long long range2 = hit*hit;
+                if (hunters->huntersStage[i] == 0)
+                {
+                    long long see = 2 * (hunters->size[i] + config->max_swallow_health);
+                    if (see*see > range2)
+                        range2 = see*see;
+                }
+
+                int contact = 0;
+                if (!safeZone->active)
+                    contact = FirstPathContact(hunters->x[i], hunters->dx[i], hunters->a[i], hunters->b[i], event - 1, swallow->x, swallow->y, range2);
+                if (contact)
+                    event = contact;
+            }
+
+            // Nothing happens till the end of the frame
+            if (event > steps)
+            {
+                hunters->x[i] += steps*hunters->dx[i];
+                hunters->y[i] = (hunters->a[i]*hunters->x[i]) + hunters->b[i];
+                break;
+            }
+
+            hunters->x[i] += (event - 1)*hunters->dx[i];
+            step += event;
+            if (!HunterStep(hunters, i, swallow, config, safeZone, timer))
+                break;
+        }
+
+        GridMove(hunters->grid, i, hunters->x[i], hunters->y[i]);
+    }
+    else // Wait some time and fly towards the swallow to interupt
+    {
+        // Wait some time
+        if (hunters->hunterWaitTime[i] - *timer < config->hunter_attack_after_time)
+        {
+            hunters->speed[i] = 0;
+            return;
+        }
+
+        // Update the path (linear function) to match the swallow possition
+        if (hunters->x[i] < swallow->x)
+            hunters->dx[i] = 1;
+        else
+            hunters->dx[i] = -1;
+
+        if (hunters->x[i] - swallow->x != 0)
+            hunters->a[i] = (float)(hunters->y[i] - swallow->y) / (float)(hunters->x[i] - swallow->x);
+        else
+            hunters->a[i] = 0;
+
+        hunters->b[i] = swallow->y - (hunters->a[i] * swallow->x);
+        hunters->huntersStage[i] = 2;
+        hunters->speed[i] = 1;
+    }
+}
+
+
+// Draw star with index i at its position
+void DrawStars(WIN* playWin, Stars* stars, int i)
+{
+    // make star blinking with different colors
+    if(stars->animationFrame[i] % 3)
+	    SetPen(playWin, stars->color);
+    else
+        SetPen(playWin, stars->color2);
+
+    stars->animationFrame[i] += 1;
+    stars->animationFrame[i] %= 3;
+    
+    DrawCell(playWin, stars->y[i], stars->x[i], '*');
+    // Increase animation frame to make blinking possible
+    stars->animationFrame[i]+=1;
+}
+
+
+// Moves star with index i by frame
+void MoveStar(Stars* stars, int i, Swallow* swallow, CONFIG_FILE* config)
+{
+    // star falls straight, so only the steps where it touches the swallow or falls behind the screen are made one by one
+    int steps = stars->fallingSpeed[i];
+    while (steps > 0)
+    {
+        int event = config->rows - 1 - stars->y[i];
+        if (event < 1)
+            event = 1;
+
+        int contact = FirstContactStep(stars->x[i], stars->y[i], 0, 1, event - 1, swallow->x, swallow->y, (long long)swallow->hp*swallow->hp);
+        if (contact)
+            event = contact;
+
+        // Nothing happens till the end of the frame
+        if (event > steps)
+        {
+            stars->y[i] += steps;
+            break;
+        }
+
+        stars->y[i] += event;
+        steps -= event;
+
+        CheckStarsCollision(swallow, stars, i, config);
+
+        // respawn star at a top if felt behind the screen
+        if(stars->y[i] >= config->rows-1)
+        {
+            stars->y[i] %= config->rows-1;
+            stars->x[i] = Random(&stars->random)%(config->cols-1) +1;
+        }
+    }
+
+    GridMove(stars->grid, i, stars->x[i], stars->y[i]);
+}
+
+
+// Draw safe zone to save swallow
+void DrawSafeZone(SafeZone* safeZone, Swallow* swallow, CONFIG_FILE* config)
+{
+    SetPen(safeZone->playWin, safeZone->color);
+
+    // draw the circle in the middle of the screen
+    for (int x = config->cols / 2 - 2 * safeZone->range; x <= config->cols / 2 + 2 * safeZone->range; x++)
+    {
+        for (int y = config->rows / 2 - safeZone->range; y <= config->rows / 2 + safeZone->range; y++)
+        {
+            float dx = (x - safeZone->x);
+            float dy = (y - safeZone->y);
+
+            if (0.25*dx*dx+dy*dy <= 4*safeZone->range*safeZone->range) // draw the circle if fragment in range
+            {
+                dx = x - swallow->x;
+                dy = y - swallow->y;
+
+                float distance = dx*dx + dy*dy;
+                // if doesnt collide with swallow, draw fragment. It is neccesary to actually see the swallow in the circle
+                if (distance > swallow->hp*swallow->hp*2)
+                {
+                    DrawCell(safeZone->playWin, y, x, ' ');
+                }
+            }
+        }
+    }
+}
+
+
+// Draw taxo
+void DrawTaxi(TAXI* taxi)
+{
+    SetPen(taxi->playWin, taxi->color);
+
+    // draw the square of taxi
+    DrawCell(taxi->playWin, (int)taxi->y, (int)taxi->x, ' ');
+    DrawCell(taxi->playWin, (int)taxi->y, (int)taxi->x + 1, ' ');
+    DrawCell(taxi->playWin, (int)taxi->y, (int)taxi->x - 1, ' ');
+    DrawCell(taxi->playWin, (int)taxi->y, (int)taxi->x + 2, ' ');
+    DrawCell(taxi->playWin, (int)taxi->y, (int)taxi->x - 2, ' ');
+
+    // draw car mask to see the taxi direction
+    if (taxi->dx > 0)
+    {
+        DrawCell(taxi->playWin, (int)taxi->y - 1, (int)taxi->x, '>');
+        DrawCell(taxi->playWin, (int)taxi->y, (int)taxi->x + 3, ' ');
+    }
+    else
+    {
+        DrawCell(taxi->playWin, (int)taxi->y - 1, (int)taxi->x, '<');
+        DrawCell(taxi->playWin, (int)taxi->y, (int)taxi->x - 3, ' ');
+    }
+
+    // darw wheels
+    SetPen(taxi->playWin, MAIN_COLOR);
+    DrawCell(taxi->playWin, (int)taxi->y+1, (int)taxi->x + 2, 'O');
+    DrawCell(taxi->playWin, (int)taxi->y+1, (int)taxi->x - 2, 'O');
+
+
+}
+
+
+// move taxi 1) to the swallow 2) to the safe zone 3) to the starting point
+void MoveTaxi(TAXI* taxi, Swallow* swallow, SafeZone* safeZone, CONFIG_FILE* config)
+{
+    if (taxi->stage > 2)
+    {
+        safeZone->active = false;
+        return;
+    }
+
+    float x, y;
+    if (taxi->stage == 0) // check teh stage of taxi
+    {
+        // set direction to the swallow
+        x = swallow->x;
+        y = swallow->y;
+    }
+    else if(taxi->stage == 1)
+    {
+        // set direction to the safe zone
+        SetSafeZone(safeZone, swallow, true, config);
+        x = config->cols/2;
+        y = config->rows/2;
+    }
+    else
+    {
+        // set direction to the start point of the taxi
+        x = config->cols/2;
+        y = -1;
+    }
+
+    // calculate distance between taxi and direction point
+    taxi->dx = x - taxi->x;
+    taxi->dy = y - taxi->y;
+    float distance = sqrt(taxi->dx*taxi->dx + taxi->dy*taxi->dy);
+
+    // go to the next stage if previous is done
+    if (distance <= swallow->hp)
+        taxi->stage += 1;
+
+    if (distance != 0) {
+        taxi->dx /= distance;
+        taxi->dy /= distance;
+    }
+
+    // move taxi by directions and speed
+    taxi->x += taxi->dx*taxi->speed;
+    taxi->y += taxi->dy*taxi->speed;
+}
+
+
+// Clean the play window
+void CleanWin(WIN* W, int border)
+{
+	int i, j;
+
+	// Set window color
+	wattron(W->window, COLOR_PAIR(W->color));
+
+	// Draw border if requested
+	if (border) box(W->window, 0, 0);
+
+	// Fill window with spaces (clearing it)
+	for (i = border; i < W->rows - border; i++)
+		for (j = border; j < W->cols - border; j++)
+			mvwprintw(W->window, i, j, " ");
+
+	// Stage changes, they are sent with the next frame
+	wnoutrefresh(W->window);
+}
+
+
+// Returns how many arena bytes a frame of the window needs
+size_t FramebufferArenaSize(int rows, int cols)
+{
+    int size = rows * cols;
+
+    return ARENA_SIZE(sizeof(FRAMEBUFFER)) + 3 * ARENA_SIZE(size * sizeof(chtype)) +
+        ARENA_SIZE(size * sizeof(int)) + 2 * ARENA_SIZE(rows * sizeof(int));
+}
+
+
+// Makes the frame empty again, as the window after CleanWin
+void ResetFramebuffer(WIN* W)
+{
+    FRAMEBUFFER* frame = W->frame;
+    int size = W->rows * W->cols;
+
+    memcpy(frame->cells, frame->background, size * sizeof(chtype));
+    memcpy(frame->shown, frame->background, size * sizeof(chtype));
+
+    for (int y = 0; y < W->rows; y++)
+    {
+        frame->dirtyFrom[y] = W->cols;
+        frame->dirtyTo[y] = -1;
+    }
+
+    frame->drawnCount = 0;
+    frame->drawnOverflow = false;
+}
+
+
+// Returns a frame for the window, it starts as the empty window drawn by CleanWin
+FRAMEBUFFER* InitFramebuffer(ARENA* arena, WIN* W, int border)
+{
+    FRAMEBUFFER* frame = (FRAMEBUFFER*)ArenaAlloc(arena, sizeof(FRAMEBUFFER));
+    int size = W->rows * W->cols;
+
+    frame->background = (chtype*)ArenaAlloc(arena, size * sizeof(chtype));
+    frame->cells = (chtype*)ArenaAlloc(arena, size * sizeof(chtype));
+    frame->shown = (chtype*)ArenaAlloc(arena, size * sizeof(chtype));
+    frame->drawnCells = (int*)ArenaAlloc(arena, size * sizeof(int));// every cell can be remembered once
+    frame->dirtyFrom = (int*)ArenaAlloc(arena, W->rows * sizeof(int));
+    frame->dirtyTo = (int*)ArenaAlloc(arena, W->rows * sizeof(int));
+
+    // Empty window: spaces inside and a box around them
+    chtype color = COLOR_PAIR(W->color);
+    for (int y = 0; y < W->rows; y++)
+    {
+        for (int x = 0; x < W->cols; x++)
+        {
+            chtype ch = ' ';
+            if (border && (y == 0 || y == W->rows - 1) && (x == 0 || x == W->cols - 1))
+                ch = y == 0 ? (x == 0 ? ACS_ULCORNER : ACS_URCORNER) : (x == 0 ? ACS_LLCORNER : ACS_LRCORNER);
+            else if (border && (y == 0 || y == W->rows - 1))
+                ch = ACS_HLINE;
+            else if (border && (x == 0 || x == W->cols - 1))
+                ch = ACS_VLINE;
+            frame->background[y * W->cols + x] = ch | color;
+        }
+    }
+
+    W->frame = frame;
+    ResetFramebuffer(W);
+    return frame;
+}
+
+
+// Erase only the cells drawn since the last cleaning, cost depends on the drawn objects not on the window size
+void CleanDrawnCells(WIN* W)
+{
+    FRAMEBUFFER* frame = W->frame;
+
+    if (frame->drawnOverflow)
+    {
+        memcpy(frame->cells, frame->background, W->rows * W->cols * sizeof(chtype));
+        for (int y = 0; y < W->rows; y++)
+            MarkDirty(frame, y, 0, W->cols - 1);
+    }
+    else
+    {
+        for (int i = 0; i < frame->drawnCount; i++)
+        {
+            int cell = frame->drawnCells[i];
+            frame->cells[cell] = frame->background[cell];
+            MarkDirty(frame, cell / W->cols, cell % W->cols, cell % W->cols);
+        }
+    }
+
+    frame->drawnCount = 0;
+    frame->drawnOverflow = false;
+}
+
+
+// Send to the window only the runs of cells that differ from the shown frame
+void FlushFramebuffer(WIN* W)
+{
+    FRAMEBUFFER* frame = W->frame;
+
+    for (int y = 0; y < W->rows; y++)
+    {
+        chtype* cells = frame->cells + y * W->cols;
+        chtype* shown = frame->shown + y * W->cols;
+        int x = frame->dirtyFrom[y];
+
+        while (x <= frame->dirtyTo[y])
+        {
+            // skip cells that didn't change
+            if (cells[x] == shown[x])
+            {
+                x++;
+                continue;
+            }
+
+            // find where the changed run ends and write it at once
+            int start = x;
+            while (x <= frame->dirtyTo[y] && cells[x] != shown[x])
+            {
+                shown[x] = cells[x];
+                x++;
+            }
+            mvwaddchnstr(W->window, y, start, cells + start, x - start);
+        }
+
+        frame->dirtyFrom[y] = W->cols;
+        frame->dirtyTo[y] = -1;
+    }
+}
+
+
+// Initialize and return the default window
+WIN* InitWin(ARENA* arena, WINDOW* parent, int rows, int cols, int y, int x, int color, int border, int delay)
+{
+	// Take memory for WIN structure from the arena
+	WIN* W = (WIN*)ArenaAlloc(arena, sizeof(WIN));
+
+	W->x = x;
+	W->y = y;
+	W->rows = rows;
+	W->cols = cols;
+	W->color = color;
+	W->frame = NULL;
+	W->pen = color;
+
+	W->window = subwin(parent, rows, cols, y, x);
+
+	// Clear the window
+	CleanWin(W, border);
+
+	// Set input mode: delay==0 means non-blocking (for real-time games)
+	if (delay == 0) nodelay(W->window, TRUE);
+
+	// Display the window
+	wrefresh(W->window);
+
+	return W;
+}
+
+
+// Returns all stars with default values
+Stars* InitStars(ARENA* arena, int color, int color2, CONFIG_FILE* config)
+{
+    Stars* stars = (Stars*)ArenaAlloc(arena, sizeof(Stars));
+    int count = config->max_stars_count;
+
+    // Taking memory for every property of stars from the arena
+    stars->count = count;
+    stars->x = (int*)ArenaAlloc(arena, count * sizeof(int));
+    stars->y = (int*)ArenaAlloc(arena, count * sizeof(int));
+    stars->fallingSpeed = (int*)ArenaAlloc(arena, count * sizeof(int));
+    stars->animationFrame = (int*)ArenaAlloc(arena, count * sizeof(int));
+    stars->color = color;
+    stars->color2 = color2;
+    stars->stars_scoring_weight = config->stars_scoring_weight;
+    stars->grid = InitGrid(arena, config, count);
+    SeedRandom(&stars->random, config->seed, STARS_STREAM);
+
+    for (int i = 0; i < count; i++)
+    {
+        stars->x[i] = Random(&stars->random)%config->cols;
+        stars->y[i] = -Random(&stars->random)%config->rows;
+        stars->fallingSpeed[i] = Random(&stars->random)%config->max_stars_speed+1;
+        stars->animationFrame[i] = 0;
+        GridMove(stars->grid, i, stars->x[i], stars->y[i]);
+    }
+
+    return stars;
+    
+}
+
+
+// Returns swallow with default values
+Swallow* InitSwallow(ARENA* arena, WIN* playWin, int x, int y, int dx, int dy, int speed, int color, CONFIG_FILE* config)
+{
+    Swallow* swallow = (Swallow*)ArenaAlloc(arena, sizeof(Swallow)); //Taking memory for Swallow from the arena
+
+    //Seting swallow's properties
+    swallow->playWin = playWin;
+    swallow->x = x;
+    swallow->y = y;
+    swallow->dx = dx;
+    swallow->dy = dy;
+    swallow->wallet = 0;
+    swallow->speed = START_PLAYER_SPEED;
+    swallow->color = color;
+    swallow->animationFrame = 0;
+    swallow->hp = config->max_swallow_health;
+
+    return swallow;
+}
+
+
+// Returns all hunters with default values
+Hunters* InitHunters(ARENA* arena, int color, Swallow* swallow, CONFIG_FILE* config)
+{
+    Hunters* hunters = (Hunters*)ArenaAlloc(arena, sizeof(Hunters));
+    int count = config->max_hunters_count;
+
+    // Taking memory for every property of hunters from the arena
+    hunters->count = count;
+    hunters->x = (int*)ArenaAlloc(arena, count * sizeof(int));
+    hunters->y = (int*)ArenaAlloc(arena, count * sizeof(int));
+    hunters->size = (int*)ArenaAlloc(arena, count * sizeof(int));
+    hunters->dx = (int*)ArenaAlloc(arena, count * sizeof(int));
+    hunters->a = (float*)ArenaAlloc(arena, count * sizeof(float));
+    hunters->b = (float*)ArenaAlloc(arena, count * sizeof(float));
+    hunters->speed = (int*)ArenaAlloc(arena, count * sizeof(int));
+    hunters->animationFrame = (int*)ArenaAlloc(arena, count * sizeof(int));
+    hunters->boundsCounter = (int*)ArenaAlloc(arena, count * sizeof(int));
+    hunters->onTheScreen = (short int*)ArenaAlloc(arena, count * sizeof(short int));
+    hunters->huntersStage = (short int*)ArenaAlloc(arena, count * sizeof(short int));
+    hunters->hunterWaitTime = (float*)ArenaAlloc(arena, count * sizeof(float));
+    hunters->color = color;
+    hunters->grid = InitGrid(arena, config, count);
+    SeedRandom(&hunters->random, config->seed, HUNTERS_STREAM);
+
+    float timer = 0; //create timer with value 0 to set to the hunter
+    for (int i = 0; i < count; i++)
+        SpawnHunter(hunters, i, swallow, config, &timer);
+
+    return hunters;
+}
+
+
+// Makes address of the ranking file of the level with the extension
+void RankingAddress(char* address, size_t size, const char* level, const char* extension)
+{
+    snprintf(address, size, "./rankings/%s%s", level, extension);
+}
+
+
+// Tells which score is better: more points, then less time used, then more life remaining (negative if a is better)
+int CompareScores(const Ranking* a, const Ranking* b)
+{
+    if (a->points != b->points)
+        return a->points > b->points ? -1 : 1;
+    if (a->timeUsed != b->timeUsed)
+        return a->timeUsed < b->timeUsed ? -1 : 1;
+    if (a->lifeRemaining != b->lifeRemaining)
+        return a->lifeRemaining > b->lifeRemaining ? -1 : 1;
+    return 0;
+}
+
+
+// Writes count records of the level to its ranking file, returns false if it couldnt be written
+bool WriteRanking(const char* level, Ranking* records, int count)
+{
+    char address[150], temporary[150];
+    RankingAddress(address, sizeof(address), level, ".rank");
+    RankingAddress(temporary, sizeof(temporary), level, ".rank.tmp");
+
+    // The file is written next to the old one and replaces it only when it is complete
+    FILE* f = fopen(temporary, "wb");
+    if (!f)
+        return false;
+
+    RANKING_HEADER header = { .version = RANKING_VERSION, .count = count, .recordSize = sizeof(Ranking) };
+    memcpy(header.magic, RANKING_MAGIC, sizeof(header.magic));
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(records, sizeof(Ranking), count, f);
+
+    bool written = !ferror(f) && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    fclose(f);
+    if (!written || rename(temporary, address) != 0)
+    {
+        remove(temporary);
+        return false;
+    }
+    return true;
+}
+
+
+// Converts the old text ranking of the level ("place nick points time life" lines) to a ranking file, returns false if there is none
+bool ImportRanking(const char* level)
+{
+    char address[150], line[300];
+    RankingAddress(address, sizeof(address), level, "");
+
+    FILE* f = fopen(address, "r");
+    if (!f)
+        return false;
+
+    int count = 0, capacity = 16;
+    Ranking* records = (Ranking*)malloc(capacity * sizeof(Ranking));
+    while (fgets(line, sizeof(line), f))
+    {
+        Ranking ranking = { 0 };
+        int place;
+
+        // Checks if scaning finished
+        if (sscanf(line, "%d %99s %d %f %d", &place, ranking.nick, &ranking.points, &ranking.timeUsed, &ranking.lifeRemaining) != 5)
+            continue;
+
+        if (count == capacity)
+        {
+            capacity *= 2;
+            records = (Ranking*)realloc(records, capacity * sizeof(Ranking));
+        }
+        records[count++] = ranking;
+    }
+    fclose(f);
+
+    WriteRanking(level, records, count);
+    free(records);
+    return true;
+}
+
+
+// Maps the ranking file of the level into memory, the old text ranking is converted the first time. Level without a ranking gives empty map
+void MapRanking(RANKING_MAP* map, const char* level)
+{
+    char address[150];
+    RankingAddress(address, sizeof(address), level, ".rank");
+
+    map->memory = NULL;
+    map->size = 0;
+    map->count = 0;
+
+    int fd = open(address, O_RDONLY);
+    if (fd < 0 && ImportRanking(level))
+        fd = open(address, O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(RANKING_HEADER))
+    {
+        map->memory = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map->memory == MAP_FAILED)
+            map->memory = NULL;
+        else
+            map->size = info.st_size;
+    }
+    close(fd);
+
+    if (!map->memory)
+        return;
+
+    // File from another version or cut in the middle is used as an empty ranking, indexes of the older files are skipped
+    RANKING_HEADER* header = (RANKING_HEADER*)map->memory;
+    size_t expected = sizeof(RANKING_HEADER) + (size_t)header->count * sizeof(Ranking);
+    if (memcmp(header->magic, RANKING_MAGIC, sizeof(header->magic)) != 0 ||
+        (header->version != RANKING_VERSION && header->version != RANKING_INDEXED) ||
+        header->recordSize != sizeof(Ranking) || map->size < expected)
+        return;
+
+    map->count = header->count;
+    map->records = (Ranking*)(header + 1);
+}
+
+
+// Unmaps the ranking file
+void UnmapRanking(RANKING_MAP* map)
+{
+    if (map->memory)
+        munmap(map->memory, map->size);
+    map->memory = NULL;
+    map->count = 0;
+}
+
+
+// Appends the score to the journal of the level with one write, so a crash can cut only this score. Returns false if it couldnt be written
+bool AppendJournal(const char* level, Ranking* score)
+{
+    char address[150];
+    RankingAddress(address, sizeof(address), level, ".journal");
+
+    int fd = open(address, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+
+    // score cut by a crash of some game is dropped, otherwise every next score would be read shifted
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size % sizeof(Ranking) != 0 && ftruncate(fd, info.st_size - info.st_size % sizeof(Ranking)) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    bool written = write(fd, score, sizeof(Ranking)) == sizeof(Ranking);
+    close(fd);
+    return written;
+}
+
+
+// Locks the ranking files of the level against other games (flock of rankings/<level>.lock), returns descriptor for UnlockRanking, -1 if it couldnt be locked
+int LockRanking(const char* level)
+{
+    char address[150];
+    RankingAddress(address, sizeof(address), level, ".lock");
+
+    int fd = open(address, O_RDWR | O_CREAT, 0644);
+    if (fd >= 0 && flock(fd, LOCK_EX) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+
+// Unlocks the ranking files (closing the lock file releases the flock)
+void UnlockRanking(int fd)
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+
+RANKING_TABLE* rankingCache = NULL;    // Rankings of the levels already used by this process
+
+
+// Returns true if record a is before record b in the ranking (better score, equal scores in the order they were added)
+bool ScoreBefore(Ranking* records, uint32_t a, uint32_t b)
+{
+    int result = CompareScores(&records[a], &records[b]);
+    return result < 0 || (result == 0 && a < b);
+}
+
+
+// Returns hash of the nick (FNV-1a)
+uint32_t NickHash(const char* nick)
+{
+    uint32_t hash = 2166136261u;
+    for (; *nick; nick++)
+        hash = (hash ^ (unsigned char)*nick) * 16777619u;
+    return hash;
+}
+
+
+// Returns slot of the nick in the hash, or the empty slot where it should be put
+int HashSlot(RANKING_TABLE* table, const char* nick)
+{
+    int slot = NickHash(nick) & (table->hashSize - 1);
+    while (table->hash[slot] >= 0 && strcmp(table->records[table->hash[slot]].nick, nick) != 0)
+        slot = (slot + 1) & (table->hashSize - 1);
+    return slot;
+}
+
+
+// Puts the record into the hash, the hash grows before it is half full
+void HashInsert(RANKING_TABLE* table, uint32_t record)
+{
+    if (2 * (table->count + 1) > table->hashSize)
+    {
+        free(table->hash);
+        table->hashSize *= 2;
+        table->hash = (int*)malloc(table->hashSize * sizeof(int));
+        for (int slot = 0; slot < table->hashSize; slot++)
+            table->hash[slot] = -1;
+        for (int i = 0; i < table->count; i++)
+            if ((uint32_t)i != record)
+                table->hash[HashSlot(table, table->records[i].nick)] = i;
+    }
+
+    table->hash[HashSlot(table, table->records[record].nick)] = record;
+}
+
+
+// Returns number of the record of the player, -1 if the player isnt in the ranking
+int FindPlayer(RANKING_TABLE* table, const char* nick)
+{
+    return table->hash[HashSlot(table, nick)];
+}
+
+
+// Returns new skip list node with the number of levels
+SKIP_NODE* NewSkipNode(uint32_t record, int height)
+{
+    SKIP_NODE* node = (SKIP_NODE*)malloc(sizeof(SKIP_NODE) + height * sizeof(node->link[0]));
+    node->record = record;
+    node->height = height;
+
+    // not linked yet, links at the end count the position after the last record
+    for (int level = 0; level < height; level++)
+    {
+        node->link[level].next = NULL;
+        node->link[level].width = 1;
+    }
+    return node;
+}
+
+
+// Finds the last node before the record on every level and the place of those nodes, returns the place the record has (or would have)
+int SkipSearch(RANKING_TABLE* table, uint32_t record, SKIP_NODE* before[SKIP_LEVELS], int place[SKIP_LEVELS])
+{
+    SKIP_NODE* node = table->head;
+    int position = 0;
+
+    for (int level = SKIP_LEVELS - 1; level >= 0; level--)
+    {
+        while (node->link[level].next && ScoreBefore(table->records, node->link[level].next->record, record))
+        {
+            position += node->link[level].width;
+            node = node->link[level].next;
+        }
+        before[level] = node;
+        place[level] = position;
+    }
+
+    return position + 1;
+}
+
+
+// Puts the record into the skip list at the place of its score
+void SkipInsert(RANKING_TABLE* table, uint32_t record)
+{
+    SKIP_NODE* before[SKIP_LEVELS];
+    int place[SKIP_LEVELS];
+    SkipSearch(table, record, before, place);
+
+    // every next level has half as many nodes
+    int height = 1;
+    while (height < SKIP_LEVELS && (Random(&table->random) & 1))
+        height++;
+
+    SKIP_NODE* node = NewSkipNode(record, height);
+    for (int level = 0; level < SKIP_LEVELS; level++)
+    {
+        if (level < height)
+        {
+            node->link[level].next = before[level]->link[level].next;
+            node->link[level].width = before[level]->link[level].width - (place[0] - place[level]);
+            before[level]->link[level].next = node;
+            before[level]->link[level].width = place[0] - place[level] + 1;
+        }
+        else
+            before[level]->link[level].width++;
+    }
+
+    table->nodes[record] = node;
+}
+
+
+// Takes the record out of the skip list, it has to be called before its score changes
+void SkipRemove(RANKING_TABLE* table, uint32_t record)
+{
+    SKIP_NODE* before[SKIP_LEVELS];
+    int place[SKIP_LEVELS];
+    SkipSearch(table, record, before, place);
+
+    SKIP_NODE* node = table->nodes[record];
+    for (int level = 0; level < SKIP_LEVELS; level++)
+    {
+        if (level < node->height)
+        {
+            before[level]->link[level].width += node->link[level].width - 1;
+            before[level]->link[level].next = node->link[level].next;
+        }
+        else
+            before[level]->link[level].width--;
+    }
+
+    free(node);
+    table->nodes[record] = NULL;
+}
+
+
+// Returns place of the player in the ranking (from 1), 0 if the player isnt in it
+int PlayerPlace(RANKING_TABLE* table, const char* nick)
+{
+    SKIP_NODE* before[SKIP_LEVELS];
+    int place[SKIP_LEVELS];
+
+    int record = FindPlayer(table, nick);
+    return record < 0 ? 0 : SkipSearch(table, record, before, place);
+}
+
+
+// Makes sure there is space for one more record
+void GrowRanking(RANKING_TABLE* table)
+{
+    if (table->count < table->capacity)
+        return;
+
+    table->capacity *= 2;
+    table->records = (Ranking*)realloc(table->records, table->capacity * sizeof(Ranking));
+    table->nodes = (SKIP_NODE**)realloc(table->nodes, table->capacity * sizeof(SKIP_NODE*));
+}
+
+
+// Puts the score of the player into the ranking if it is new or better than the old one, returns true if the ranking changed
+bool SetScore(RANKING_TABLE* table, Ranking* score)
+{
+    int record = FindPlayer(table, score->nick);
+
+    if (record >= 0)
+    {
+        // if the score isnt better, nothing changes
+        if (table->records[record].points >= score->points)
+            return false;
+
+        // the record leaves the list before the change and comes back at its new place
+        SkipRemove(table, record);
+        table->records[record] = *score;
+        SkipInsert(table, record);
+        return true;
+    }
+
+    // Add new Player if this one doesnt exist
+    GrowRanking(table);
+    record = table->count;
+    table->records[record] = *score;
+    HashInsert(table, record);
+    table->count++;
+    SkipInsert(table, record);
+    return true;
+}
+
+
+// Reads the ranking file of the level into the ranking, replacing what was in it
+void LoadRanking(RANKING_TABLE* table)
+{
+    for (int i = 0; i < table->count; i++)
+        free(table->nodes[i]);
+    table->count = 0;
+    for (int slot = 0; slot < table->hashSize; slot++)
+        table->hash[slot] = -1;
+
+    // empty list, links at the end count the position after the last record
+    for (int level = 0; level < SKIP_LEVELS; level++)
+    {
+        table->head->link[level].next = NULL;
+        table->head->link[level].width = 1;
+    }
+
+    RANKING_MAP map;
+    MapRanking(&map, table->level);
+    for (int i = 0; i < map.count; i++)
+    {
+        GrowRanking(table);
+        table->records[i] = map.records[i];
+        HashInsert(table, i);
+        table->count++;
+        SkipInsert(table, i);
+    }
+    UnmapRanking(&map);
+}
+
+
+// Puts the scores added to the journal of the level since the last read into its ranking, a cut score at the end is skipped
+void ReadJournal(RANKING_TABLE* table)
+{
+    char address[150];
+    RankingAddress(address, sizeof(address), table->level, ".journal");
+
+    FILE* f = fopen(address, "rb");
+    if (!f)
+        return;
+
+    Ranking score;
+    fseek(f, table->journalRead, SEEK_SET);
+    while (fread(&score, sizeof(Ranking), 1, f) == 1)
+    {
+        score.nick[RANKING_NICK - 1] = '\0';
+        SetScore(table, &score);
+        table->journalRead += sizeof(Ranking);
+    }
+    table->journaled = table->journalRead / sizeof(Ranking);
+    fclose(f);
+}
+
+
+// Remembers which ranking file of the level was read
+void StatRanking(RANKING_TABLE* table)
+{
+    char address[150];
+    RankingAddress(address, sizeof(address), table->level, ".rank");
+
+    struct stat info;
+    if (stat(address, &info) != 0)
+        memset(&info, 0, sizeof(info));
+    table->rankInode = info.st_ino;
+    table->rankTime = info.st_mtim;
+}
+
+
+// Brings the ranking up to date with the files written by every game, the files have to be locked
+void SyncRanking(RANKING_TABLE* table)
+{
+    ino_t inode = table->rankInode;
+    struct timespec time = table->rankTime;
+    StatRanking(table);
+
+    // a new ranking file means the journal was folded into it, so everything is read again
+    if (!table->loaded || inode != table->rankInode || time.tv_sec != table->rankTime.tv_sec || time.tv_nsec != table->rankTime.tv_nsec)
+    {
+        LoadRanking(table);
+        StatRanking(table);
+        table->journalRead = 0;
+        table->loaded = true;
+    }
+
+    ReadJournal(table);
+}
+
+
+// Folds the journal into the ranking file, the journal is removed only after the new file replaced the old one. The files have to be locked.
+// Returns false if the new file couldnt be written, the scores stay in the journal then
+bool CompactRanking(RANKING_TABLE* table)
+{
+    char address[150];
+    RankingAddress(address, sizeof(address), table->level, ".journal");
+
+    // scores of the other games have to get into the new file too
+    SyncRanking(table);
+    if (!WriteRanking(table->level, table->records, table->count))
+        return false;
+    remove(address);
+
+    StatRanking(table);
+    table->journalRead = 0;
+    table->journaled = 0;
+    return true;
+}
+
+
+// Returns ranking of the level, the first time the level is used an empty one is made
+RANKING_TABLE* CachedRanking(const char* level)
+{
+    for (RANKING_TABLE* table = rankingCache; table; table = table->next)
+        if (strcmp(table->level, level) == 0)
+            return table;
+
+    RANKING_TABLE* table = (RANKING_TABLE*)malloc(sizeof(RANKING_TABLE));
+    snprintf(table->level, sizeof(table->level), "%s", level);
+    table->count = 0;
+    table->capacity = 16;
+    table->records = (Ranking*)malloc(table->capacity * sizeof(Ranking));
+    table->nodes = (SKIP_NODE**)malloc(table->capacity * sizeof(SKIP_NODE*));
+    table->hashSize = 32;
+    table->hash = (int*)malloc(table->hashSize * sizeof(int));
+    table->head = NewSkipNode(0, SKIP_LEVELS);
+
+    // empty ranking until the files are read, it is shown like that if they cant be locked
+    for (int slot = 0; slot < table->hashSize; slot++)
+        table->hash[slot] = -1;
+    for (int level = 0; level < SKIP_LEVELS; level++)
+    {
+        table->head->link[level].next = NULL;
+        table->head->link[level].width = 1;
+    }
+    SeedRandom(&table->random, 0, RANKING_STREAM);
+    table->loaded = false;
+    table->journalRead = 0;
+    table->journaled = 0;
+
+    table->next = rankingCache;
+    rankingCache = table;
+    return table;
+}
+
+
+// Returns ranking of the level with the scores of every game that finished so far. If the files couldnt be locked, the last read ranking is returned
+RANKING_TABLE* GetRanking(const char* level)
+{
+    RANKING_TABLE* table = CachedRanking(level);
+    int lock = LockRanking(level);
+    if (lock < 0)
+        return table;
+
+    SyncRanking(table);
+    UnlockRanking(lock);
+    return table;
+}
+
+
+// Puts the score into the ranking of the level, a changed score is appended to the journal. Many games can do it at the same time.
+// Returns false if the score wasnt saved (the files couldnt be locked or written), nothing is written without the lock
+bool RecordScore(const char* level, Ranking* score)
+{
+    int lock = LockRanking(level);
+    if (lock < 0)
+        return false;
+
+    RANKING_TABLE* table = CachedRanking(level);
+    SyncRanking(table);
+
+    bool saved = true;
+    if (SetScore(table, score))
+    {
+        // the ranking file is rewritten only when the journal is as long as the ranking (or the score couldnt be appended)
+        if (AppendJournal(level, score))
+            table->journaled++;
+        else
+            saved = CompactRanking(table);
+
+        if (table->journaled >= JOURNAL_MIN && table->journaled >= table->count)
+            CompactRanking(table);
+    }
+
+    UnlockRanking(lock);
+    return saved;
+}
+
+
+// Frees rankings of every level, scores still in a journal are folded into the ranking file first
+void FreeRankings()
+{
+    while (rankingCache)
+    {
+        RANKING_TABLE* next = rankingCache->next;
+        if (rankingCache->journaled > 0)
+        {
+            // without the lock the journal is left for the next game to fold
+            int lock = LockRanking(rankingCache->level);
+            if (lock < 0 || !CompactRanking(rankingCache))
+                fprintf(stderr, "Ranking of %s couldn't be rewritten, its scores stay in rankings/%s.journal\n", rankingCache->level, rankingCache->level);
+            UnlockRanking(lock);
+        }
+        for (int i = 0; i < rankingCache->count; i++)
+            free(rankingCache->nodes[i]);
+        free(rankingCache->head);
+        free(rankingCache->nodes);
+        free(rankingCache->hash);
+        free(rankingCache->records);
+        free(rankingCache);
+        rankingCache = next;
+    }
+}
+
+
+// Return main window and define ncurses colors
+WINDOW* Start()
+{
+    WINDOW* win;
+    //checking inicialization of the window (ncurses)
+    if(!(win = initscr()))
+    {
+        //showing error
+        fprintf(stderr, "Error while initializing ncurses!");
+        exit(1);
+    }
+
+    // bytes of every frame are counted on the thread that draws them
+    drawCounters = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+
+    start_color();// turns on the colors in terminal
+
+    //define ncurses colors
+	init_pair(MAIN_COLOR, COLOR_WHITE, COLOR_BLACK);
+	init_pair(STAT_COLOR, COLOR_YELLOW, COLOR_BLACK);
+	init_pair(PLAY_COLOR, COLOR_CYAN, COLOR_BLACK);
+	init_pair(SWALLOW_COLOR, COLOR_GREEN, COLOR_BLACK);
+    init_pair(HUNTER_COLOR, COLOR_RED, COLOR_BLACK);
+    init_pair(ALBATROS_TAXI_COLOR, COLOR_WHITE, COLOR_YELLOW);
+    init_pair(END_COLOR, COLOR_RED, COLOR_BLACK);
+    init_pair(AGAIN_COLOR, COLOR_MAGENTA, COLOR_BLACK);
+    init_pair(STAR_COLOR, COLOR_YELLOW, COLOR_BLACK);
+    init_pair(STAR2_COLOR, COLOR_WHITE, COLOR_BLACK);
+    init_pair(SAFE_ZONE_COLOR, COLOR_CYAN, COLOR_CYAN);
+    init_pair(BOSS_COLOR, COLOR_MAGENTA, COLOR_MAGENTA);
+    init_pair(RANKING_COLOR, COLOR_YELLOW, COLOR_BLACK);
+
+    //makes input invisible
+    noecho();
+
+    //makes cursor invisible
+    curs_set(0);
+
+    return win;
+
+}
+
+
+// Displaying the ranking already read for some level, the files aren't touched
+void DrawRanking(WIN* rankingWin, CONFIG_FILE* config, RANKING_TABLE* table, char* level, char playerName[100])
+{
+    // Set status bar color
+    wattron(rankingWin->window, COLOR_PAIR(rankingWin->color));
+
+    // Draw border around status bar
+    box(rankingWin->window, 0, 0);
+
+    // display level kind info
+    char levelInfo[50], rankingInfo[50];
+    snprintf(levelInfo, sizeof(levelInfo), "Level: %s", level);
+
+    // Display status info, with the place of the player if he is already in the ranking
+    int place = PlayerPlace(table, playerName);
+    if (place > 0)
+        mvwprintw(rankingWin->window, 1, 2, "%s (#%d)", playerName, place);
+    else
+        mvwprintw(rankingWin->window, 1, 2, "%s", playerName);
+    mvwprintw(rankingWin->window, 2, 2, "%s", levelInfo);
+    mvwprintw(rankingWin->window, 3, 2, "Nr Nick Pts Tm Lf");
+
+    // display the best players that fit in the window, places are counted while going through the list
+    SKIP_NODE* node = table->head->link[0].next;
+    for (int i = 0; node && i +4 < config->rows; i++, node = node->link[0].next)
+    {
+        Ranking* ranking = &table->records[node->record];
+        snprintf(rankingInfo, sizeof(rankingInfo), "%d %s %d %.2f %d", i + 1, ranking->nick, ranking->points, ranking->timeUsed, ranking->lifeRemaining);
+        mvwprintw(rankingWin->window, i+4, 2, "%s", rankingInfo);
+    }
+
+    // Stage changes, they are sent with the next frame
+    wnoutrefresh(rankingWin->window);
+}
+
+
+// Displaying the ranking for some level with the scores of every game that finished so far
+void RankingStatus(WIN* rankingWin, CONFIG_FILE* config, char* level, char playerName[100])
+{
+    DrawRanking(rankingWin, config, GetRanking(level), level, playerName);
+}
+
+
+//  Displaying number of gained stars, actual speed and controls
+void UpdateStatus(WIN* statusWin, Swallow* swallow, CONFIG_FILE* config)
+{
+	// Set status bar color
+	wattron(statusWin->window, COLOR_PAIR(statusWin->color));
+
+	// Draw border around status bar
+	box(statusWin->window, 0, 0);
+
+    char info[50];
+    snprintf(info, sizeof(info), "Number of gained stars: %d    Swallows speed: %d", swallow->wallet, swallow->speed);
+    char controls[] = "W (up), S (down), D (right), A (left) | O (slow down), P (go faster), SPACE (safe zone)";
+
+    // Display status info
+	mvwprintw(statusWin->window, 1, (config->cols-(sizeof(info)/sizeof(char)))/2, info);
+
+	// Display controls
+	mvwprintw(statusWin->window, 3, (config->cols-(sizeof(controls)/sizeof(char)))/2, controls);
+
+	// Stage changes, they are sent with the next frame
+	wnoutrefresh(statusWin->window);
+}
+
+
+// Display how many bytes the drawing thread passed to write() for a frame, "n/a" where the system doesnt count them
+void UpdateFrameInfo(WIN* statusWin, VIEW* view, CONFIG_FILE* config)
+{
+	wattron(statusWin->window, COLOR_PAIR(statusWin->color));
+
+    char info[80];
+    if (drawCounters < 0)
+        snprintf(info, sizeof(info), "Frame write() bytes: n/a");
+    else
+        snprintf(info, sizeof(info), "Frame write() bytes: last %6ld  average %6lld",
+            view->frameBytes, view->frames ? view->totalBytes / view->frames : 0);
+
+    // Display frame info between gained stars and controls
+	mvwprintw(statusWin->window, 2, (config->cols-(int)strlen(info))/2, "%s", info);
+
+	// Stage changes, they are sent with the next frame
+	wnoutrefresh(statusWin->window);
+}
+
+
+// Display time left and actual health points
+void UpdateLifeInfo(WIN* lifeinfo, Swallow* swallow, float *timer, CONFIG_FILE* config)
+{
+    // Set status bar color
+	wattron(lifeinfo->window, COLOR_PAIR(lifeinfo->color));
+
+	// Draw border around status bar
+	box(lifeinfo->window, 0, 0);
+
+    char life[50];
+    snprintf(life, sizeof(life), "Health Points: %d", swallow->hp);
+    char time[50];
+    snprintf(time, sizeof(time), "Time Left: %.1f", *timer);
+
+    // Display life info
+	mvwprintw(lifeinfo->window, 1, OFFX, life);
+
+	// Display time left
+	mvwprintw(lifeinfo->window, 1, config->cols/3-OFFX, time);
+
+	// Stage changes, they are sent with the next frame
+	wnoutrefresh(lifeinfo->window);
+}
+
+
+// Say goodbye to the player
+void EndScreen(WIN* playWin, CONFIG_FILE* config)
+{
+    CleanWin(playWin, BORDER);
+
+    // Set text color
+	wattron(playWin->window, COLOR_PAIR(END_COLOR));
+
+	// Draw border around text
+	box(playWin->window, 0, 0);
+
+    char endText[] = "Bye bye, thanks for playing!";
+
+    //Display end text
+	mvwprintw(playWin->window, config->rows/2, (config->cols-(sizeof(endText)/sizeof(char)))/2, endText);
+
+	// Update display
+	wrefresh(playWin->window);
+    sleep(1);
+}
+
+
+// Ask player if he want to try again
+void AgainScreen(WIN* playWin, char *resultText, CONFIG_FILE* config)
+{
+    CleanWin(playWin, BORDER);
+
+    // Set text color
+	wattron(playWin->window, COLOR_PAIR(AGAIN_COLOR));
+
+	// Draw border around text
+	box(playWin->window, 0, 0);
+
+    char* question = "Click 'r' to play again and 'q' if you don't ;)";
+
+    //Display result text
+	mvwprintw(playWin->window, config->rows/2-2, (config->cols-(sizeof(resultText)/sizeof(char)))/2.2f, resultText);
+	mvwprintw(playWin->window, config->rows/2, (config->cols-(sizeof(question)/sizeof(char)))/3.2f, question);
+
+	// Update display
+	wrefresh(playWin->window);
+}
+
+
+// add the best score or change if exist to the payer in ranking, returns false if it couldnt be saved
+bool AddScore(Swallow* swallow, char playerName[], char* level, CONFIG_FILE* config, float * timer)
 {
-    switch (input)
-    {
-    case 's':               // sets swallows direction to down
-        swallow->dx = 0;
-        swallow->dy = 1;
-        break;
-    
-    case 'w':               // sets swallows direction to up
-        swallow->dx = 0;
-        swallow->dy = -1;
-        break;
+    Ranking score = { 0 };
+    snprintf(score.nick, sizeof(score.nick), "%s", playerName);
+    score.points = swallow->wallet;
+    score.timeUsed = config->start_time - *timer;
+    score.lifeRemaining = swallow->hp;
 
-    case 'd':               // sets swallows direction to right
-        swallow->dx = 1;
-        swallow->dy = 0;
-        break;
+    return RecordScore(level, &score);
+}
 
-    case 'a':               // sets swallows direction to left
-        swallow->dx = -1;
-        swallow->dy = 0;
-        break;
 
-    case 'o':               // makes swallow slower
-        if(swallow->speed > 1)
-            swallow->speed -= 1;
-        break;
+// Give feedback for player of his actual playthrough
+void PlayAgain(WIN* playWin,WIN* rankingWin, Swallow* swallow, bool* isPlaying, CONFIG_FILE* config, char* playerName, char* level, float* timer)
+{
+    int ch;
+    char* resultText;
+    bool saved = true;
+    // write the result
+    if (swallow->hp > 0)
+    {
+        resultText = "You won, congarts!";
+        saved = AddScore(swallow, playerName, level, config, timer);
+    }
+    else
+        resultText = "You have lost!";
 
-    case 'p':               // makes swallow faster
-        if(swallow->speed < 5)
-            swallow->speed = swallow->speed +1;
-        break;
+    RankingStatus(rankingWin, config, level, playerName);
+    if (!saved)
+        mvwprintw(rankingWin->window, 0, 2, "score not saved");
+    AgainScreen(playWin, resultText, config);
 
-    case ' ':               // calls albatros taxi
-        if (taxi->stage >= 3)
+    // wait for players decision to continue or end the game
+    while(1)
+    {
+        ch = wgetch(playWin->window);
+        if(ch == ESCAPE)
         {
-            SetTaxi(taxi, swallow, config);
-            taxi->stage = 0;
+            *isPlaying = false;
+            break;
         }
-        break;
-    
-    default:
-        break;
+        else if(ch == REPEAT)
+            break;
     }
-    
-    MoveSwallow(swallow, stars, hunters, config, safeZone, timer);
 }
 
 
-// Draw Swallow shape
-void DrawSwallow(WIN* playWin, Swallow* swallow)
+// Returns config address of the level ("default" or NULL means the .conf file)
+void LevelAddress(char* level, char configAdress[100])
 {
-	wattron(playWin->window, COLOR_PAIR(swallow->color));
+    if (level == NULL || strcmp(level, "default") == 0)
+        strcpy(configAdress, ".conf");
+    else
+        snprintf(configAdress, 100, "./levels/%s", level);
+}
 
-    // Draws exact frame. Depends of the size of the swallow
-    switch (swallow->animationFrame % 4)
+
+LEVEL_CATALOG levelCatalog = { 0 };    // Levels of the levels folder
+
+
+// Compares levels by name (qsort)
+int CompareLevels(const void* a, const void* b)
+{
+    return strcmp(((const LEVEL*)a)->name, ((const LEVEL*)b)->name);
+}
+
+
+// Adds level with the name at the end of the catalog
+void AddLevel(LEVEL_CATALOG* catalog, const char* name)
+{
+    if (catalog->count == catalog->capacity)
     {
-    case 0:
-        for (int i = 0; i < swallow->hp; i++)
-        {
-            if(swallow->y-i >=0 && swallow->x-(i+1)>=0)
-                mvwprintw(playWin->window, swallow->y-i, swallow->x-(i+1), "\\");
-            if(swallow->y-i >=0 && swallow->x+i>=0)
-                mvwprintw(playWin->window, swallow->y-i, swallow->x+i, "/");
-        }
-        break;
-    case 1:
-        for (int i = 0; i < swallow->hp; i++)
+        catalog->capacity = catalog->capacity ? 2 * catalog->capacity : 16;
+        catalog->levels = (LEVEL*)realloc(catalog->levels, catalog->capacity * sizeof(LEVEL));
+    }
+
+    LEVEL* level = &catalog->levels[catalog->count++];
+    snprintf(level->name, sizeof(level->name), "%s", name);
+    level->config = NULL;
+}
+
+
+// Reads names of the levels from the catalog in the cache if it was made for the same version of the folder, returns false if it wasnt
+bool ReadLevelCatalog(LEVEL_CATALOG* catalog, int64_t modified)
+{
+    FILE* f = fopen("./.cache/levels", "rb");
+    if (!f)
+        return false;
+
+    CATALOG_HEADER header;
+    bool read = fread(&header, sizeof(header), 1, f) == 1 &&
+        memcmp(header.magic, CATALOG_MAGIC, sizeof(header.magic)) == 0 && header.version == CATALOG_VERSION &&
+        header.nameSize == LEVEL_NAME && header.modified == modified;
+
+    char name[LEVEL_NAME];
+    for (uint32_t i = 0; read && i < header.count; i++)
+    {
+        read = fread(name, LEVEL_NAME, 1, f) == 1;
+        name[LEVEL_NAME - 1] = '\0';
+        if (read)
+            AddLevel(catalog, name);
+    }
+    fclose(f);
+
+    return read;
+}
+
+
+// Writes names of the levels to the catalog in the cache, the old one is replaced only by a complete file
+void WriteLevelCatalog(LEVEL_CATALOG* catalog)
+{
+    char temporary[50];
+    snprintf(temporary, sizeof(temporary), "./.cache/levels.%d", (int)getpid());
+
+    mkdir("./.cache", 0755);
+    FILE* f = fopen(temporary, "wb");
+    if (!f)
+        return;
+
+    CATALOG_HEADER header = { { 0 }, CATALOG_VERSION, catalog->modified, catalog->count, LEVEL_NAME };
+    memcpy(header.magic, CATALOG_MAGIC, sizeof(header.magic));
+    bool written = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (int i = 0; written && i < catalog->count; i++)
+        written = fwrite(catalog->levels[i].name, LEVEL_NAME, 1, f) == 1;
+
+    if (fclose(f) != 0 || !written || rename(temporary, "./.cache/levels") != 0)
+        remove(temporary);
+}
+
+
+// Brings the catalog up to date with the levels folder, the folder is read only if it changed since the catalog was made
+void RefreshLevels(LEVEL_CATALOG* catalog)
+{
+    struct stat info;
+    int64_t modified = 0;
+    if (stat("./levels/", &info) == 0)
+        modified = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+
+    if (catalog->scanned && catalog->modified == modified)
+        return;
+
+    for (int i = 0; i < catalog->count; i++)
+        free(catalog->levels[i].config);
+    catalog->count = 0;
+    catalog->modified = modified;
+    catalog->scanned = true;
+
+    if (ReadLevelCatalog(catalog, modified))
+        return;
+    catalog->count = 0;
+
+    // hidden files and names too long for a level are skipped
+    DIR* dir = opendir("./levels/");
+    struct dirent* file;
+    while (dir && (file = readdir(dir)) != NULL)
+        if (file->d_name[0] != '.' && strlen(file->d_name) < LEVEL_NAME)
+            AddLevel(catalog, file->d_name);
+    if (dir)
+        closedir(dir);
+
+    qsort(catalog->levels, catalog->count, sizeof(LEVEL), CompareLevels);
+    WriteLevelCatalog(catalog);
+}
+
+
+// Finds levels whose names start with the prefix, returns their number and puts the first one to first
+int FindLevels(LEVEL_CATALOG* catalog, const char* prefix, int* first)
+{
+    size_t length = strlen(prefix);
+
+    // binary search of the first name not before the prefix and of the first one after every name with the prefix
+    int from = 0, to = catalog->count;
+    while (from < to)
+    {
+        int middle = (from + to) / 2;
+        if (strncmp(catalog->levels[middle].name, prefix, length) < 0)
+            from = middle + 1;
+        else
+            to = middle;
+    }
+    *first = from;
+
+    to = catalog->count;
+    while (from < to)
+    {
+        int middle = (from + to) / 2;
+        if (strncmp(catalog->levels[middle].name, prefix, length) <= 0)
+            from = middle + 1;
+        else
+            to = middle;
+    }
+
+    return from - *first;
+}
+
+
+// Returns config of the level with the number, the level file is read the first time
+CONFIG_FILE* LevelConfig(LEVEL_CATALOG* catalog, int number)
+{
+    LEVEL* level = &catalog->levels[number];
+    if (!level->config)
+    {
+        char configAdress[100];
+        LevelAddress(level->name, configAdress);
+        level->config = getConfigInfo(configAdress);
+    }
+
+    return level->config;
+}
+
+
+// Frees the catalog with configs of the levels
+void FreeLevels(LEVEL_CATALOG* catalog)
+{
+    for (int i = 0; i < catalog->count; i++)
+        free(catalog->levels[i].config);
+    free(catalog->levels);
+    memset(catalog, 0, sizeof(LEVEL_CATALOG));
+}
+
+
+// Prints names of count levels from the first one, not more than LEVELS_SHOWN
+void PrintLevels(LEVEL_CATALOG* catalog, int first, int count)
+{
+    for (int i = first; i < first + count && i < first + LEVELS_SHOWN; i++)
+        printf("%s\n", catalog->levels[i].name);
+    if (count > LEVELS_SHOWN)
+        printf("... i %d więcej, wpisz początek nazwy\n", count - LEVELS_SHOWN);
+}
+
+
+// Form for player to get level and nick, the level can be chosen by the beginning of its name
+void AskPlayer(char* playerName, char configAdress[100], char* level)
+{
+    char fileName[LEVEL_NAME];
+
+    // ask for players nick, it can have spaces
+    printf("Podaj nazwę gracza: \n");
+    scanf(" %99[^\n]", playerName);
+
+    // if there are no levels, set config file as default
+    RefreshLevels(&levelCatalog);
+    strcpy(level, "default");
+    if (levelCatalog.count == 0)
+    {
+        LevelAddress(level, configAdress);
+        return;
+    }
+
+    printf("\nWybierz poziom trudności:\n");
+    PrintLevels(&levelCatalog, 0, levelCatalog.count);
+
+    // ask again while the name fits more than one level, the exact name is always chosen
+    while (scanf("%49s", fileName) == 1)
+    {
+        int first;
+        int found = FindLevels(&levelCatalog, fileName, &first);
+
+        if (found == 1 || (found > 1 && strcmp(levelCatalog.levels[first].name, fileName) == 0))
+            strcpy(level, levelCatalog.levels[first].name);
+        else if (found > 1)
         {
-            if(swallow->y >=0 && swallow->x-(i+1)-i>=0)
-                mvwprintw(playWin->window, swallow->y, swallow->x-(i+1), "-");
-            if(swallow->y >=0 && swallow->x+i>=0)
-                mvwprintw(playWin->window, swallow->y, swallow->x+i, "-");
+            printf("\nPasuje kilka poziomów:\n");
+            PrintLevels(&levelCatalog, first, found);
+            continue;
         }
         break;
-    case 2:
-        for (int i = 0; i < swallow->hp; i++)
+    }
+
+    // if cant find level, config file is the default one
+    LevelAddress(level, configAdress);
+}
+
+// Returns how many arena bytes a game session needs
+size_t GameArenaSize(CONFIG_FILE* config)
+{
+    size_t stars = config->max_stars_count;
+    size_t hunters = config->max_hunters_count;
+
+    return ARENA_SIZE(sizeof(Swallow)) + ARENA_SIZE(sizeof(Boss)) + ARENA_SIZE(sizeof(SafeZone)) + ARENA_SIZE(sizeof(TAXI)) +
+        ARENA_SIZE(sizeof(Stars)) + 4 * ARENA_SIZE(stars * sizeof(int)) + GridArenaSize(config, stars) +
+        ARENA_SIZE(sizeof(Hunters)) + 7 * ARENA_SIZE(hunters * sizeof(int)) + 3 * ARENA_SIZE(hunters * sizeof(float)) + 2 * ARENA_SIZE(hunters * sizeof(short int)) +
+        GridArenaSize(config, hunters);
+}
+
+
+TRACE* activeTrace = NULL;      // Trace given with --trace, every game of the program writes to it
+
+
+// Writes the records of a buffer to the trace file in its format (writer thread)
+void WriteTraceRecords(TRACE* trace, TRACE_RECORD* records, int count)
+{
+    for (int r = 0; r < count; r++)
+    {
+        TRACE_RECORD* record = &records[r];
+
+        if (!trace->json)
         {
-            if(swallow->y+i >=0 && swallow->x-(i+1)>=0)
-                mvwprintw(playWin->window, swallow->y+i, swallow->x-(i+1), "/");
-            if(swallow->y+i >=0 && swallow->x+i>=0)
-                mvwprintw(playWin->window, swallow->y+i, swallow->x+i, "\\");
+            fprintf(trace->file, "%lld,%ld,%d", record->time / 1000, record->tick, record->ticks);
+            for (int part = 0; part < PROFILE_PARTS; part++)
+                fprintf(trace->file, ",%lld", record->ns[part]);
+            fprintf(trace->file, ",%d,%d,%d,%ld,%ld,%d,%d\n", record->hunters, record->stars, record->boss,
+                record->starTests, record->hunterTests, record->hp, record->wallet);
+            continue;
         }
-        break;
 
-    case 3:
-        for (int i = 0; i < swallow->hp; i++)
+        // parts of the frame follow each other, so they are placed one after another before its end
+        long long begin = record->time;
+        for (int part = 0; part < PROFILE_PARTS; part++)
+            begin -= record->ns[part];
+        for (int part = 0; part < PROFILE_PARTS; part++)
         {
-            if(swallow->y >=0 && swallow->x-(i+1)>=0)
-                mvwprintw(playWin->window, swallow->y, swallow->x-(i+1), "-");
-            if(swallow->y >=0 && swallow->x+i>=0)
-                mvwprintw(playWin->window, swallow->y, swallow->x+i, "-");
+            if (record->ns[part] == 0)
+                continue;
+            fprintf(trace->file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"tick\":%ld}}",
+                trace->written ? ",\n" : "", profileParts[part], begin / 1000.0, record->ns[part] / 1000.0, record->tick);
+            trace->written = true;
+            begin += record->ns[part];
         }
-        break;
-    
-    default:
-        break;
+        fprintf(trace->file, "%s{\"name\":\"entities\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"hunters\":%d,\"stars\":%d,\"boss\":%d}},\n"
+            "{\"name\":\"collision tests\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"stars\":%ld,\"hunters\":%ld}},\n"
+            "{\"name\":\"swallow\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"hp\":%d,\"wallet\":%d}}",
+            trace->written ? ",\n" : "", record->time / 1000.0, record->hunters, record->stars, record->boss,
+            record->time / 1000.0, record->starTests, record->hunterTests, record->time / 1000.0, record->hp, record->wallet);
+        trace->written = true;
     }
+}
 
-    // Increase animation frame to "move" the swallow
-    swallow->animationFrame +=1;
+
+// Writes every buffer given by the game till the trace is closed (writer thread)
+void* TraceWriter(void* data)
+{
+    TRACE* trace = (TRACE*)data;
+
+    pthread_mutex_lock(&trace->lock);
+    while (true)
+    {
+        while (!trace->pending && !trace->closing)
+            pthread_cond_wait(&trace->wake, &trace->lock);
+        if (!trace->pending)
+            break;
+
+        // the game fills only the other buffer, so this one is written without the lock
+        TRACE_RECORD* records = trace->buffers[1 - trace->filling];
+        int count = trace->pending;
+        pthread_mutex_unlock(&trace->lock);
+        WriteTraceRecords(trace, records, count);
+        pthread_mutex_lock(&trace->lock);
+
+        trace->pending = 0;
+        pthread_cond_broadcast(&trace->wake);
+    }
+    pthread_mutex_unlock(&trace->lock);
+
+    return NULL;
+}
+
+
+// Opens the trace file (.csv - CSV, anything else - Chrome trace JSON) and starts its writer, returns false if it cant be written
+bool OpenTrace(TRACE* trace, const char* address)
+{
+    memset(trace, 0, sizeof(TRACE));
+    trace->file = fopen(address, "w");
+    if (!trace->file)
+        return false;
+
+    size_t length = strlen(address);
+    trace->json = !(length >= 4 && strcmp(address + length - 4, ".csv") == 0);
+    trace->buffers[0] = (TRACE_RECORD*)malloc(2 * TRACE_RECORDS * sizeof(TRACE_RECORD));
+    trace->buffers[1] = trace->buffers[0] + TRACE_RECORDS;
+    trace->start = MonotonicNs();
+
+    if (trace->json)
+        fprintf(trace->file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    else
+    {
+        fprintf(trace->file, "time_us,tick,ticks");
+        for (int part = 0; part < PROFILE_PARTS; part++)
+            fprintf(trace->file, ",%s_ns", profileParts[part]);
+        fprintf(trace->file, ",hunters,stars,boss,star_tests,hunter_tests,hp,wallet\n");
+    }
+
+    pthread_mutex_init(&trace->lock, NULL);
+    pthread_cond_init(&trace->wake, NULL);
+    pthread_create(&trace->writer, NULL, TraceWriter, trace);
+    return true;
+}
+
+
+// Gives the filled buffer to the writer, records are dropped if it is still busy (the game never waits for it)
+void SendTraceRecords(TRACE* trace)
+{
+    pthread_mutex_lock(&trace->lock);
+    if (trace->pending == 0)
+    {
+        trace->pending = trace->count;
+        trace->filling = 1 - trace->filling;
+        pthread_cond_broadcast(&trace->wake);
+    }
+    else
+        trace->dropped += trace->count;
+    trace->count = 0;
+    pthread_mutex_unlock(&trace->lock);
+}
+
+
+// Writes the last records, waits for the writer and closes the trace file
+void CloseTrace(TRACE* trace)
+{
+    pthread_mutex_lock(&trace->lock);
+    while (trace->pending)
+        pthread_cond_wait(&trace->wake, &trace->lock);
+    trace->pending = trace->count;
+    trace->filling = 1 - trace->filling;
+    trace->count = 0;
+    trace->closing = true;
+    pthread_cond_broadcast(&trace->wake);
+    pthread_mutex_unlock(&trace->lock);
+    pthread_join(trace->writer, NULL);
+
+    if (trace->json)
+        fprintf(trace->file, "\n],\"otherData\":{\"droppedFrames\":%ld}}\n", trace->dropped);
+    if (trace->dropped)
+        fprintf(stderr, "trace: %ld frames dropped, the writer couldnt keep up\n", trace->dropped);
+    fclose(trace->file);
+    free(trace->buffers[0]);
+    pthread_mutex_destroy(&trace->lock);
+    pthread_cond_destroy(&trace->wake);
+}
+
+
+// Closes the trace given with --trace when the program ends
+void CloseActiveTrace()
+{
+    if (activeTrace)
+        CloseTrace(activeTrace);
+    activeTrace = NULL;
+}
+
+
+// Starts a new game in the trace, the game is measured by the profile of the trace if it had none
+void StartTrace(TRACE* trace, GAME* game)
+{
+    if (!game->profile)
+        game->profile = &trace->profile;
+
+    memcpy(trace->last, game->profile->ns, sizeof(trace->last));
+    trace->lastTicks = game->profile->ticks;
+    trace->lastTests[0] = game->stars->grid->tests;
+    trace->lastTests[1] = game->hunters->grid->tests;
 }
 
 
-// Bounce hunter from the frame
-void BounceHunter(Hunter* hunter, CONFIG_FILE* config)
+// Returns number of the hunters that already joined the game. Hunter i joins when the time left drops below its share of the start time,
+// so the first one that joined is found by a binary search with the same condition as the game loop uses
+int JoinedHunters(GAME* game)
 {
-    if (hunter->y < 0)
+    int from = 0, to = game->hunters->count;
+    while (from < to)
     {
-        hunter->y = 0;
-        hunter->a *= -1;
-        hunter->b = hunter->y - (hunter->a * hunter->x);
-        hunter->boundsCounter -= 1;
-        hunter->huntersStage = 0;
+        int middle = (from + to) / 2;
+        if (game->timer < middle * game->config->start_time / game->config->max_hunters_count)
+            to = middle;
+        else
+            from = middle + 1;
     }
-    else if (hunter->y > config->rows - 2)
+
+    return game->hunters->count - from;
+}
+
+
+// Adds the frame that just ended to the trace, only numbers are copied here
+void TraceFrame(TRACE* trace, GAME* game)
+{
+    PROFILE* profile = game->profile;
+    TRACE_RECORD* record = &trace->buffers[trace->filling][trace->count];
+
+    record->time = MonotonicNs() - trace->start;
+    record->tick = profile->ticks;
+    record->ticks = profile->ticks - trace->lastTicks;
+    for (int part = 0; part < PROFILE_PARTS; part++)
     {
-        hunter->y = config->rows - 2;
-        hunter->a *= -1;
-        hunter->b = hunter->y - (hunter->a * hunter->x);
-        hunter->boundsCounter -= 1;
-        hunter->huntersStage = 0;
+        record->ns[part] = profile->ns[part] - trace->last[part];
+        trace->last[part] = profile->ns[part];
     }
+    trace->lastTicks = profile->ticks;
+
+    record->hunters = JoinedHunters(game);
+    record->stars = game->stars->count;
+    record->boss = game->boss->onTheScreen;
+
+    record->starTests = game->stars->grid->tests - trace->lastTests[0];
+    record->hunterTests = game->hunters->grid->tests - trace->lastTests[1];
+    trace->lastTests[0] = game->stars->grid->tests;
+    trace->lastTests[1] = game->hunters->grid->tests;
+    record->hp = game->swallow->hp;
+    record->wallet = game->swallow->wallet;
+
+    if (++trace->count == TRACE_RECORDS)
+        SendTraceRecords(trace);
+}
+
+
+TELEMETRY_FEED* activeTelemetry = NULL;  // Live counters of this process, every single game publishes to it
 
 
-    if (hunter->x < 1)
+// Makes the shared memory segment of this process for pp1-top, returns false if it cant be made
+bool OpenTelemetry(TELEMETRY_FEED* feed, const char* level, const char* player)
+{
+    memset(feed, 0, sizeof(TELEMETRY_FEED));
+    snprintf(feed->name, sizeof(feed->name), "/" TELEMETRY_PREFIX "%d", (int)getpid());
+
+    int fd = shm_open(feed->name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, sizeof(TELEMETRY)) != 0)
     {
-        hunter->x = 1;
-        hunter->a *= -1;
-        hunter->b = hunter->y - (hunter->a * hunter->x);
-        hunter->dx *= -1;
-        hunter->boundsCounter -= 1;
-        hunter->huntersStage = 0;
+        close(fd);
+        shm_unlink(feed->name);
+        return false;
     }
-    else if (hunter->x > config->cols - 2)
+
+    feed->shared = (TELEMETRY*)mmap(NULL, sizeof(TELEMETRY), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (feed->shared == MAP_FAILED)
     {
-        hunter->x = config->cols - 2;
-        hunter->a *= -1;
-        hunter->b = hunter->y - (hunter->a * hunter->x);
-        hunter->dx *= -1;
-        hunter->boundsCounter -= 1;
-        hunter->huntersStage = 0;
+        shm_unlink(feed->name);
+        return false;
     }
+
+    // the segment is new and filled with zeros, so the magic comes last
+    snprintf(feed->data.level, sizeof(feed->data.level), "%s", level);
+    snprintf(feed->data.player, sizeof(feed->data.player), "%s", player);
+    feed->shared->version = TELEMETRY_VERSION;
+    feed->shared->pid = getpid();
+    TelemetryWrite(feed->shared, &feed->data);
+    memcpy(feed->shared->magic, TELEMETRY_MAGIC, sizeof(feed->shared->magic));
+
+    return true;
 }
 
 
-// Draw Hunters shape
-void DrawHunter(Hunter* hunter, Swallow* swallow)
+// Removes the segment of this process when the program ends
+void CloseActiveTelemetry()
 {
-    wattron(hunter->playWin->window, COLOR_PAIR(hunter->color));
+    if (!activeTelemetry)
+        return;
 
-    // Write number of bounces above the hunter
-    char counter[2];
-    snprintf(counter, sizeof(counter), "%d", hunter->boundsCounter);
-    mvwprintw(hunter->playWin->window, hunter->y - 1, hunter->x, counter);
+    munmap(activeTelemetry->shared, sizeof(TELEMETRY));
+    shm_unlink(activeTelemetry->name);
+    activeTelemetry = NULL;
+}
 
-    // Draws exact frame. Depends of the size of the hunter.
-    switch (hunter->animationFrame % 4)
-    {
-    case 0:
-        for (int i = 0; i < hunter->size; i++)
-        {
-            if (hunter->y - i >= 0 && hunter->x - (i + 1) >= 0)
-                mvwprintw(hunter->playWin->window, hunter->y - i, hunter->x - (i + 1), "\\");
-            if (hunter->y - i >= 0 && hunter->x + i >= 0)
-                mvwprintw(hunter->playWin->window, hunter->y - i, hunter->x + i, "/");
-        }
-        break;
-    case 1:
-        for (int i = 0; i < hunter->size; i++)
-        {
-            if (hunter->y >= 0 && hunter->x - (i + 1) - i >= 0)
-                mvwprintw(hunter->playWin->window, hunter->y, hunter->x - (i + 1), "-");
-            if (hunter->y >= 0 && hunter->x + i >= 0)
-                mvwprintw(hunter->playWin->window, hunter->y, hunter->x + i, "-");
-        }
-        break;
-    case 2:
-        for (int i = 0; i < hunter->size; i++)
-        {
-            if (hunter->y + i >= 0 && hunter->x - (i + 1) >= 0)
-                mvwprintw(hunter->playWin->window, hunter->y + i, hunter->x - (i + 1), "/");
-            if (hunter->y + i >= 0 && hunter->x + i >= 0)
-                mvwprintw(hunter->playWin->window, hunter->y + i, hunter->x + i, "\\");
-        }
-        break;
 
-    case 3:
-        for (int i = 0; i < hunter->size; i++)
-        {
-            if (hunter->y >= 0 && hunter->x - (i + 1) >= 0)
-                mvwprintw(hunter->playWin->window, hunter->y, hunter->x - (i + 1), "-");
-            if (hunter->y >= 0 && hunter->x + i >= 0)
-                mvwprintw(hunter->playWin->window, hunter->y, hunter->x + i, "-");
-        }
-        break;
+// Starts publishing the telemetry of this process, nothing happens if the segment cant be made
+void StartTelemetry(const char* level, const char* player)
+{
+    static TELEMETRY_FEED feed;
 
-    default:
-        break;
-    }
+    if (activeTelemetry || !OpenTelemetry(&feed, level, player))
+        return;
+    activeTelemetry = &feed;
+    atexit(CloseActiveTelemetry);
+}
 
-    // Increase animation frame to "move" the hunter
-    hunter->animationFrame += 1;
+
+// Counts a new round of the game in the telemetry
+void StartRound(TELEMETRY_FEED* feed, GAME* game)
+{
+    feed->data.rounds++;
+    feed->data.tickRate = game->config->tick_rate;
+    feed->lastTests[0] = game->stars->grid->tests;
+    feed->lastTests[1] = game->hunters->grid->tests;
 }
 
 
-// Moves hunter by frame
-void MoveHunter(Hunter* hunter, Swallow* swallow, CONFIG_FILE* config,SafeZone* safeZone, float* timer)
+// Copies the state of the game after the frame to the shared memory, only memory is written (no system calls)
+void PublishTelemetry(TELEMETRY_FEED* feed, GAME* game, int ticks, long long frameNs)
 {
-    // Cheks if can bounce
-    if (hunter->boundsCounter <= 0)
-        SpawnHunter(hunter, swallow, config, timer);
+    TELEMETRY_DATA* data = &feed->data;
+
+    data->ticks += ticks;
+    data->frames++;
+    data->frameTimes[TelemetryBucket(frameNs)]++;
+    data->timer = game->timer;
+    data->hp = game->swallow->hp;
+    data->wallet = game->swallow->wallet;
+
+    data->hunters = JoinedHunters(game);
+    data->stars = game->stars->count;
+    data->boss = game->boss->onTheScreen;
+
+    data->starTests += game->stars->grid->tests - feed->lastTests[0];
+    data->hunterTests += game->hunters->grid->tests - feed->lastTests[1];
+    feed->lastTests[0] = game->stars->grid->tests;
+    feed->lastTests[1] = game->hunters->grid->tests;
+    data->updated = MonotonicNs();
+
+    TelemetryWrite(feed->shared, data);
+}
 
-    // Moves hunter (depends of stage)
-    if (hunter->huntersStage != 1)
-    {
-        // Fly with a path
-        for (int i = 0; i < hunter->speed; i++)
-        {
-            hunter->x += hunter->dx;
-            hunter->y = (hunter->a*hunter->x) + hunter->b;
 
-            if (hunter->onTheScreen == 0)
-            {
-                if (hunter->x <= config->cols - 2 && hunter->x >= 1 && hunter->y <= config->rows - 2 && hunter->y >= 0)
-                    hunter->onTheScreen = 1;
-                else
-                    break;
-            }
+// Creates every object of a single game session in the arena, playWin can be NULL when there is no terminal
+void InitGame(GAME* game, ARENA* arena, CONFIG_FILE* config, WIN* playWin)
+{
+    game->config = config;
+    game->timer = 0;
+    game->profile = NULL;
+    game->trace = activeTrace;
+    game->telemetry = activeTelemetry;
+    game->loopAllocations = 0;
 
-            BounceHunter(hunter, config);
+    game->swallow = InitSwallow(arena, playWin, config->cols/2,config->rows/2,0,-1,START_PLAYER_SPEED,SWALLOW_COLOR,config);//  create swallow
 
-            if (!safeZone->active)
-                CheckHuntersCollision(swallow, hunter, config, safeZone, timer);
-        }
-    }
-    else // Wait some time and fly towards the swallow to interupt
-    {
-        // Wait some time
-        if (hunter->hunterWaitTime - *timer < config->hunter_attack_after_time)
-        {
-            hunter->speed = 0;
-            DrawHunter(hunter, swallow);
-            return;
-        }
+    game->boss = (Boss*)ArenaAlloc(arena, sizeof(Boss));
+    SeedRandom(&game->boss->random, config->seed, BOSS_STREAM);
+    SpawnBoss(game->boss, config, game->swallow);
+    UpdateBoss(game->boss, game->swallow, config);
 
-        // Update the path (linear function) to match the swallow possition
-        if (hunter->x < swallow->x)
-            hunter->dx = 1;
-        else
-            hunter->dx = -1;
+    game->stars = InitStars(arena, STAR_COLOR, STAR2_COLOR, config);
 
-        if (hunter->x - swallow->x != 0)
-            hunter->a = (float)(hunter->y - swallow->y) / (float)(hunter->x - swallow->x);
-        else
-            hunter->a = 0;
+    game->hunters = InitHunters(arena, HUNTER_COLOR, game->swallow, config);
 
-        hunter->b = swallow->y - (hunter->a * swallow->x);
-        hunter->huntersStage = 2;
-        hunter->speed = 1;
-    }
-    DrawHunter(hunter, swallow);
+    game->safeZone = (SafeZone*)ArenaAlloc(arena, sizeof(SafeZone));// take memory for safe zone
+    game->taxi = (TAXI*)ArenaAlloc(arena, sizeof(TAXI));// take memory for taxi
+
+    SetSafeZone(game->safeZone, game->swallow, false, config);
+    SetTaxi(game->taxi, game->swallow, config);
 }
 
 
-// Draw star at position
-void DrawStars(WIN* playWin, Star* star, Swallow* swallow, CONFIG_FILE* config)
+// Simulates a single tick of the game without drawing anything, returns false when the game is over
+bool StepGame(GAME* game, int input)
 {
-    // make star blinking with different colors
-    if(star->animationFrame % 3)
-	    wattron(playWin->window, COLOR_PAIR(star->color));
-    else
-        wattron(playWin->window, COLOR_PAIR(star->color2));
+    CONFIG_FILE* config = game->config;
+    Swallow* swallow = game->swallow;
+    TAXI* taxi = game->taxi;
 
-    star->animationFrame += 1;
-    star->animationFrame %= 3;
-    
-    mvwprintw(playWin->window, star->y, star->x, "*");
-    // Increase animation frame to make blinking possible
-    star->animationFrame+=1;
-
-    // move star step by step
-    for (int i = 0; i < star->fallingSpeed; i++)
-    {
-        star->y += 1;
+    game->timer -= 1.0 / config->tick_rate;// decrease games time
 
-        CheckStarsCollision(swallow, star, config);
+    // defining exiting protocol
+    if (input == ESCAPE || game->timer <= 0 || swallow->hp <= 0)
+        return false;
 
-        // respawn star at a top if felt behind the screen
-        if(star->y >= config->rows-1)
-        {
-            star->y %= config->rows-1;
-            star->x = rand()%(config->cols-1) +1;
-        }
+    // every part of the tick is measured when the game is benchmarked
+    long long mark = 0;
+    if (game->profile)
+    {
+        game->profile->ticks++;
+        mark = MonotonicNs();
     }
-}
 
+    PlayerMovement(swallow, input, game->stars, game->hunters, config, &game->timer, game->safeZone, taxi);
+    ProfileMark(game->profile, PROFILE_COLLISIONS, &mark);
 
-// Draw safe zone to save swallow
-void DrawSafeZone(SafeZone* safeZone, Swallow* swallow, CONFIG_FILE* config)
-{
-    wattron(safeZone->playWin->window, COLOR_PAIR(safeZone->color));
+    // move every star
+    for (int i = 0; i < game->stars->count; i++)
+        MoveStar(game->stars, i, swallow, config);
+    ProfileMark(game->profile, PROFILE_STARS, &mark);
 
-    // draw the circle in the middle of the screen
-    for (int x = config->cols / 2 - 2 * safeZone->range; x <= config->cols / 2 + 2 * safeZone->range; x++)
+    MoveBoss(game->boss, swallow, config, game->safeZone, &game->timer);
+    ProfileMark(game->profile, PROFILE_BOSS, &mark);
+
+    // swallow and taxi procedure, dependent of stage
+    if (taxi->stage >= 0 && taxi->stage <= 3)
     {
-        for (int y = config->rows / 2 - safeZone->range; y <= config->rows / 2 + safeZone->range; y++)
+        if (taxi->stage == 1)// if swallow is being caries by taxi, it should be in his position
         {
-            float dx = (x - safeZone->x);
-            float dy = (y - safeZone->y);
+            swallow->x = taxi->x;
+            swallow->y = taxi->y;
+        }
 
-            if (0.25*dx*dx+dy*dy <= 4*safeZone->range*safeZone->range) // draw the circle if fragment in range
-            {
-                dx = x - swallow->x;
-                dy = y - swallow->y;
+        MoveTaxi(taxi, swallow, game->safeZone, config);
+    }
+    ProfileMark(game->profile, PROFILE_TAXI, &mark);
 
-                float distance = dx*dx + dy*dy;
-                // if doesnt collide with swallow, draw fragment. It is neccesary to actually see the swallow in the circle
-                if (distance > swallow->hp*swallow->hp*2)
-                {
-                    mvwprintw(safeZone->playWin->window, y, x, " ");
-                }
-            }
-        }
+    // move each hunter
+    for (int i = 0; i < game->hunters->count; i++)
+    {
+        if (game->timer >= i * config->start_time / config->max_hunters_count)
+            continue;
+        MoveHunter(game->hunters, i, swallow, config, game->safeZone, &game->timer);
     }
+    ProfileMark(game->profile, PROFILE_HUNTERS, &mark);
+
+    return true;
 }
 
 
-// Draw taxo
-void DrawTaxi(TAXI* taxi)
+// Reads players key from the play window (ncurses backend), the timings key only switches the ranking window and doesnt go to the game
+int NcursesReadInput(RENDERER* renderer)
 {
-    wattron(taxi->playWin->window, COLOR_PAIR(taxi->color));
+    VIEW* view = (VIEW*)renderer->data;
 
-    // draw the square of taxi
-    mvwprintw(taxi->playWin->window, (int)taxi->y, (int)taxi->x, " ");
-    mvwprintw(taxi->playWin->window, (int)taxi->y, (int)taxi->x + 1, " ");
-    mvwprintw(taxi->playWin->window, (int)taxi->y, (int)taxi->x - 1, " ");
-    mvwprintw(taxi->playWin->window, (int)taxi->y, (int)taxi->x + 2, " ");
-    mvwprintw(taxi->playWin->window, (int)taxi->y, (int)taxi->x - 2, " ");
+    int ch = wgetch(view->playWin->window);
+    flushinp();
 
-    // draw car mask to see the taxi direction
-    if (taxi->dx > 0)
-    {
-        mvwprintw(taxi->playWin->window, (int)taxi->y - 1, (int)taxi->x, ">");
-        mvwprintw(taxi->playWin->window, (int)taxi->y, (int)taxi->x + 3, " ");
-    }
-    else
+    if (ch == PROFILE_KEY)
     {
-        mvwprintw(taxi->playWin->window, (int)taxi->y - 1, (int)taxi->x, "<");
-        mvwprintw(taxi->playWin->window, (int)taxi->y, (int)taxi->x - 3, " ");
+        view->showProfile = !view->showProfile;
+        CleanWin(view->rankingWin, BORDER);
+        // the ranking read at the start of the round is shown again, the frame loop doesnt lock or read the files
+        if (!view->showProfile && view->level)
+            DrawRanking(view->rankingWin, view->config, CachedRanking(view->level), view->level, view->playerName);
+        return ERR;
     }
 
-    // darw wheels
-    wattron(taxi->playWin->window, COLOR_PAIR(MAIN_COLOR));
-    mvwprintw(taxi->playWin->window, (int)taxi->y+1, (int)taxi->x + 2, "O");
-    mvwprintw(taxi->playWin->window, (int)taxi->y+1, (int)taxi->x - 2, "O");
-
-
+    return ch;
 }
 
 
-// move taxi 1) to the swallow 2) to the safe zone 3) to the starting point
-void MoveTaxi(TAXI* taxi, Swallow* swallow, SafeZone* safeZone, CONFIG_FILE* config)
+// Draws every object of the game into the framebuffer of the play window (cleaned with CleanDrawnCells), nothing goes to ncurses yet
+void DrawPlayArea(WIN* playWin, GAME* game)
 {
-    if (taxi->stage > 2)
-    {
-        safeZone->active = false;
-        return;
-    }
+    CONFIG_FILE* config = game->config;
+    Swallow* swallow = game->swallow;
+    TAXI* taxi = game->taxi;
 
-    float x, y;
-    if (taxi->stage == 0) // check teh stage of taxi
-    {
-        // set direction to the swallow
-        x = swallow->x;
-        y = swallow->y;
-    }
-    else if(taxi->stage == 1)
+    // draw every star
+    for (int i = 0; i < game->stars->count; i++)
+        DrawStars(playWin, game->stars, i);
+
+    // boss is shown only after his entering time
+    if (game->timer <= game->boss->enterTime)
+        DrawBoss(game->boss);
+
+    // swallow is hidden while taxi carries it
+    if (taxi->stage != 1)
+        DrawSwallow(playWin, swallow);
+
+    if (taxi->stage >= 0 && taxi->stage <= 2)
+        DrawTaxi(taxi);
+
+    if (taxi->stage >= 0 && taxi->stage <= 3 && game->safeZone->active)
+        DrawSafeZone(game->safeZone, swallow, config);
+
+    // draw each hunter that already joined the game
+    for (int i = 0; i < game->hunters->count; i++)
     {
-        // set direction to the safe zone
-        SetSafeZone(safeZone, swallow, true, config);
-        x = config->cols/2;
-        y = config->rows/2;
+        if (game->timer >= i * config->start_time / config->max_hunters_count)
+            continue;
+        DrawHunter(playWin, game->hunters, i);
     }
+}
+
+
+// Writes the time in at most 3 characters: microseconds, then milliseconds ("12m"), tenths of a second (".4s") or seconds ("3s")
+void ProfileTime(char text[4], long long ns)
+{
+    long long us = ns > 0 ? ns / 1000 : 0;
+
+    if (us < 1000)
+        snprintf(text, 4, "%lld", us);
+    else if (us < 100000)
+        snprintf(text, 4, "%lldm", us / 1000);
+    else if (us < 1000000)
+        snprintf(text, 4, ".%llds", us / 100000);
+    else if (us < 100000000)
+        snprintf(text, 4, "%llds", us / 1000000);
     else
-    {
-        // set direction to the start point of the taxi
-        x = config->cols/2;
-        y = -1;
-    }
+        snprintf(text, 4, "++");
+}
 
-    // calculate distance between taxi and direction point
-    taxi->dx = x - taxi->x;
-    taxi->dy = y - taxi->y;
-    float distance = sqrt(taxi->dx*taxi->dx + taxi->dy*taxi->dy);
 
-    // go to the next stage if previous is done
-    if (distance <= swallow->hp)
-        taxi->stage += 1;
+// Draws the timings of every part of the frame in microseconds into the ranking window, long ones in bigger units so the row fits
+void UpdateProfileInfo(WIN* rankingWin, PROFILE* profile, CONFIG_FILE* config)
+{
+    wattron(rankingWin->window, COLOR_PAIR(rankingWin->color));
+    box(rankingWin->window, 0, 0);
 
-    if (distance != 0) {
-        taxi->dx /= distance;
-        taxi->dy /= distance;
+    mvwprintw(rankingWin->window, 1, 1, "%-7s%3s%4s%4s", "us", "avg", "p99", "max");
+    for (int part = 0; part < PROFILE_PARTS && part + 2 < config->rows - 1; part++)
+    {
+        long samples = profile->samples[part] ? profile->samples[part] : 1;
+        char average[4], percentile[4], worst[4];
+        ProfileTime(average, profile->ns[part] / samples);
+        ProfileTime(percentile, ProfilePercentile(profile, part, 0.99));
+        ProfileTime(worst, profile->worst[part]);
+        mvwprintw(rankingWin->window, part + 2, 1, "%-7.7s%3s%4s%4s", profileParts[part], average, percentile, worst);
     }
 
-    // move taxi by directions and speed
-    taxi->x += taxi->dx*taxi->speed;
-    taxi->y += taxi->dy*taxi->speed;
-
-    DrawTaxi(taxi);
+    // Stage changes, they are sent with the next frame
+    wnoutrefresh(rankingWin->window);
 }
 
 
-// Clean the play window
-void CleanWin(WIN* W, int border)
+// Draws the state of the game after a tick (ncurses backend)
+void NcursesDrawFrame(RENDERER* renderer, GAME* game)
 {
-	int i, j;
+    VIEW* view = (VIEW*)renderer->data;
+    CONFIG_FILE* config = game->config;
+    Swallow* swallow = game->swallow;
+
+    // every part of the frame is measured for the timings in the ranking window
+    long long mark = game->profile ? MonotonicNs() : 0;
+    CleanDrawnCells(view->playWin);
+    ProfileMark(game->profile, PROFILE_CLEAR, &mark);
+
+    DrawPlayArea(view->playWin, game);
+    ProfileMark(game->profile, PROFILE_DRAWING, &mark);
+
+    UpdateLifeInfo(view->lifeWin, swallow, &game->timer, config);
+    UpdateStatus(view->statusWin, swallow, config);
+    UpdateFrameInfo(view->statusWin, view, config);
+    if (view->showProfile && game->profile)
+        UpdateProfileInfo(view->rankingWin, game->profile, config);
+    ProfileMark(game->profile, PROFILE_HUD, &mark);
+
+    // only changed cells of the play window go to ncurses
+    FlushFramebuffer(view->playWin);
+
+    // every window is only staged, whole frame goes to the terminal at once
+    wnoutrefresh(view->playWin->window);
+
+    long long bytesBefore = TerminalBytes();
+    doupdate();
+    ProfileMark(game->profile, PROFILE_REFRESH, &mark);
+
+    view->frameBytes = TerminalBytes() - bytesBefore;
+    view->totalBytes += view->frameBytes;
+    view->frames++;
+}
 
-	// Set window color
-	wattron(W->window, COLOR_PAIR(W->color));
 
-	// Draw border if requested
-	if (border) box(W->window, 0, 0);
+// Returns render backend that draws the game into ncurses windows
+RENDERER NcursesRenderer(VIEW* view)
+{
+    RENDERER renderer = { view, NcursesReadInput, NcursesDrawFrame, true };
+    return renderer;
+}
 
-	// Fill window with spaces (clearing it)
-	for (i = border; i < W->rows - border; i++)
-		for (j = border; j < W->cols - border; j++)
-			mvwprintw(W->window, i, j, " ");
 
-	// Refresh to show changes
-	wrefresh(W->window);
+// Returns how many arena bytes the windows of the ncurses backend need
+size_t ViewArenaSize(CONFIG_FILE* config)
+{
+    return 4 * ARENA_SIZE(sizeof(WIN)) + FramebufferArenaSize(config->rows, config->cols);
 }
 
 
-// Initialize and return the default window
-WIN* InitWin(WINDOW* parent, int rows, int cols, int y, int x, int color, int border, int delay)
+// Generates windows of the ncurses backend
+void InitView(VIEW* view, ARENA* arena, WINDOW* mainWin, CONFIG_FILE* config)
 {
-	// Allocate memory for WIN structure
-	WIN* W = (WIN*)malloc(sizeof(WIN));
-
-	W->x = x;
-	W->y = y;
-	W->rows = rows;
-	W->cols = cols;
-	W->color = color;
+    view->rankingWin = InitWin(arena, mainWin,  config->rows,   20,             OFFY,                       OFFX + config->cols,        RANKING_COLOR,      BORDER, 0);
+    view->lifeWin =    InitWin(arena, mainWin,  LIFEWINY,       config->cols/2, LIFEWINY - 1,               OFFY + config->cols / 4,    STAT_COLOR,         BORDER, 0);
+    view->playWin =    InitWin(arena, mainWin,  config->rows,   config->cols,   OFFY,                       OFFX,                       PLAY_COLOR,         BORDER, 0);
+    view->statusWin =  InitWin(arena, mainWin,  OFFY,           config->cols,   config->rows + OFFY,        OFFX,                       STAT_COLOR,         BORDER, 0);
 
-	W->window = subwin(parent, rows, cols, y, x);
+    InitFramebuffer(arena, view->playWin, BORDER);
+    view->config = config;
+}
 
-	// Clear the window
-	CleanWin(W, border);
 
-	// Set input mode: delay==0 means non-blocking (for real-time games)
-	if (delay == 0) nodelay(W->window, TRUE);
+// Cleans every window before a new round
+void CleanView(VIEW* view)
+{
+    CleanWin(view->rankingWin, BORDER);
+    CleanWin(view->lifeWin, BORDER);
+    CleanWin(view->playWin, BORDER);
+    CleanWin(view->statusWin, BORDER);
+    ResetFramebuffer(view->playWin);
+
+    view->frames = 0;
+    view->totalBytes = 0;
+}
 
-	// Display the window
-	wrefresh(W->window);
 
-	return W;
+// Deletes every window of the view, the memory stays in the arena
+void CloseView(VIEW* view)
+{
+    delwin(view->rankingWin->window);
+    delwin(view->lifeWin->window);
+    delwin(view->playWin->window);
+    delwin(view->statusWin->window);
 }
 
 
-// Returns stars list with default values
-Star** InitStars(WIN* playWin, int color, int color2, CONFIG_FILE* config)
+// Starts watching the level file. The folder is watched, because editors often save a new file and rename it over the old one
+void WatchLevel(LEVEL_WATCH* watch, const char* configAdress)
 {
-    Star** list = (Star**)malloc(config->max_stars_count * sizeof(Star*));// Allocating memory for stars
-    for (int i = 0; i < config->max_stars_count; i++)
+    char folder[100] = ".";
+    const char* slash = strrchr(configAdress, '/');
+    if (slash)
+        snprintf(folder, sizeof(folder), "%.*s", (int)(slash - configAdress), configAdress);
+    snprintf(watch->name, sizeof(watch->name), "%s", slash ? slash + 1 : configAdress);
+
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd >= 0 && inotify_add_watch(watch->fd, folder, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
     {
-        Star* tempStar = (Star*)malloc(sizeof(Star));// Allocating memory for single star
-        tempStar->playWin = playWin;
-        tempStar->x = rand()%config->cols;
-        tempStar->y = -rand()%config->rows;
-        tempStar->fallingSpeed = rand()%config->max_stars_speed+1;
-        tempStar->color = color;
-        tempStar->color2 = color2;
-        tempStar->animationFrame = 0;
-        tempStar->stars_scoring_weight = config->stars_scoring_weight;
-        list[i] = tempStar;
+        close(watch->fd);
+        watch->fd = -1;
     }
-
-    return list;
-    
 }
 
 
-// Returns swallow with default values
-Swallow* InitSwallow(WIN* playWin, int x, int y, int dx, int dy, int speed, int color, CONFIG_FILE* config)
+// Returns true if the level file was written since the last check, never waits
+bool LevelChanged(LEVEL_WATCH* watch)
 {
-    Swallow* swallow = (Swallow*)malloc(sizeof(Swallow)); //Allocating memory for Swallow
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    ssize_t length;
 
-    //Seting swallow's properties
-    swallow->playWin = playWin;
-    swallow->x = x;
-    swallow->y = y;
-    swallow->dx = dx;
-    swallow->dy = dy;
-    swallow->wallet = 0;
-    swallow->speed = START_PLAYER_SPEED;
-    swallow->color = color;
-    swallow->animationFrame = 0;
-    swallow->hp = config->max_swallow_health;
+    // events of other files of the folder are skipped
+    while (watch->fd >= 0 && (length = read(watch->fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char* next = buffer; next < buffer + length; )
+        {
+            struct inotify_event* event = (struct inotify_event*)next;
+            if (event->len > 0 && strcmp(event->name, watch->name) == 0)
+                changed = true;
+            next += sizeof(struct inotify_event) + event->len;
+        }
+    }
 
-    return swallow;
+    return changed;
 }
 
 
-// Returns hunters list with default values
-Hunter** InitHunters(WIN* playWin, int color, Swallow* swallow, CONFIG_FILE* config)
+// Stops watching the level file
+void StopWatch(LEVEL_WATCH* watch)
 {
-    Hunter** list = (Hunter**)malloc(config->max_hunters_count * sizeof(Hunter*));// Allocating memory for hunters
-    float* timer; //create timer with value 0 to set to the hunter
-    *timer = 0;
-    for (int i = 0; i < config->max_hunters_count; i++)
-    {
-        Hunter* tempHunter = (Hunter*)malloc(sizeof(Hunter));// Allocating memory for hunter
-        tempHunter->playWin = playWin;
-
-        SpawnHunter(tempHunter, swallow, config, timer);
-
-        tempHunter->color = color;
-        list[i] = tempHunter;
-    }
-    return list;
+    if (watch->fd >= 0)
+        close(watch->fd);
+    watch->fd = -1;
 }
 
 
-// Returns ranking list from file with special level
-Ranking** GetScores(const char* level)
+// Reads the changed level file into config, the arena and the windows are made again for its sizes. Returns message for the player, NULL if nothing changed
+const char* ReloadLevel(char* configAdress, CONFIG_FILE* config, ARENA* arena, VIEW* view, WINDOW* mainWin, size_t* roundStart)
 {
-    char address[100];
-    snprintf(address, sizeof(address), "./rankings/%s", level); // make adres
+    CONFIG_FILE changed;
+    char error[300];
+
+    // wrong file (for example saved in the middle of editing) leaves the old config
+    if (!LoadConfig(configAdress, &changed, error, sizeof(error)))
+        return "level file error";
+    if (memcmp(&changed, config, sizeof(CONFIG_FILE)) == 0)
+        return NULL;
+    *config = changed;
+
+    CloseView(view);
+    FreeArena(arena);
+    *arena = InitArena(ViewArenaSize(config) + GameArenaSize(config));
+
+    werase(mainWin);
+    wrefresh(mainWin);
+    InitView(view, arena, mainWin, config);
+    *roundStart = arena->used;
+
+    return "level reloaded";
+}
 
-    char line[180];
-    FILE* f = fopen(address, "r");
 
-    Ranking** rankingList = (Ranking**)malloc(sizeof(Ranking*) * 100); // Allocating memory for ranking list
+// Player without terminal never presses anything (null backend)
+int NullReadInput(RENDERER* renderer)
+{
+    (void)renderer;
+    return ERR;
+}
 
-    int i = 0;
-    Ranking* playerRanking;
-    while (fgets(line, sizeof(line), f) && i < 100)
-    {
-        playerRanking = (Ranking*)malloc(sizeof(Ranking));// Allocating memory for single ranking
-        // Checks if scaning finished
-        if (sscanf(line, "%d %s %d %f %d", &playerRanking->index, playerRanking->nick, &playerRanking->points, &playerRanking->timeUsed, &playerRanking->lifeRemaining) != 5)
-        {
-            free(playerRanking); // free allocated memory
-            continue;
-        }
-        rankingList[i++] = playerRanking;
-    }
-    fclose(f);
 
-    rankingList[i] = NULL;// set the end of the ranking list
-    return rankingList;
+// Nothing is drawn (null backend)
+void NullDrawFrame(RENDERER* renderer, GAME* game)
+{
+    (void)renderer;
+    (void)game;
 }
 
 
-// Return main window and define ncurses colors
-WINDOW* Start()
+// Returns render backend that draws nothing and doesn't wait between ticks
+RENDERER NullRenderer()
 {
-    WINDOW* win;
-    //checking inicialization of the window (ncurses)
-    if(!(win = initscr()))
-    {
-        //showing error
-        fprintf(stderr, "Error while initializing ncurses!");
-        exit(1);
-    }
+    RENDERER renderer = { NULL, NullReadInput, NullDrawFrame, false };
+    return renderer;
+}
 
-    start_color();// turns on the colors in terminal
 
-    //define ncurses colors
-	init_pair(MAIN_COLOR, COLOR_WHITE, COLOR_BLACK);
-	init_pair(STAT_COLOR, COLOR_YELLOW, COLOR_BLACK);
-	init_pair(PLAY_COLOR, COLOR_CYAN, COLOR_BLACK);
-	init_pair(SWALLOW_COLOR, COLOR_GREEN, COLOR_BLACK);
-    init_pair(HUNTER_COLOR, COLOR_RED, COLOR_BLACK);
-    init_pair(ALBATROS_TAXI_COLOR, COLOR_WHITE, COLOR_YELLOW);
-    init_pair(END_COLOR, COLOR_RED, COLOR_BLACK);
-    init_pair(AGAIN_COLOR, COLOR_MAGENTA, COLOR_BLACK);
-    init_pair(STAR_COLOR, COLOR_YELLOW, COLOR_BLACK);
-    init_pair(STAR2_COLOR, COLOR_WHITE, COLOR_BLACK);
-    init_pair(SAFE_ZONE_COLOR, COLOR_CYAN, COLOR_CYAN);
-    init_pair(BOSS_COLOR, COLOR_MAGENTA, COLOR_MAGENTA);
-    init_pair(RANKING_COLOR, COLOR_YELLOW, COLOR_BLACK);
+typedef struct {                // State of the bench backend
 
-    //makes input invisible
-    noecho();
+    WIN* playWin;               // Window that is drawn but never shown
+    RANDOM keys;                // Random keys of the player
 
-    //makes cursor invisible
-    curs_set(0);
+} BENCH;
 
-    return win;
 
+// Player of the benchmark presses random keys (but never quits), about every third tick nothing (bench and batch backend)
+int BenchReadInput(RENDERER* renderer)
+{
+    BENCH* bench = (BENCH*)renderer->data;
+    const char keys[] = "wasdop ";
+
+    int key = Random(&bench->keys) % 10;
+    return key < 7 ? keys[key] : ERR;
 }
 
 
-// Displaying the ranking for some level
-void RankingStatus(WIN* rankingWin, CONFIG_FILE* config, char* level, char playerName[100])
+// Draws the play area into its framebuffer and measures it, nothing is sent to the terminal (bench backend)
+void BenchDrawFrame(RENDERER* renderer, GAME* game)
 {
-    // Set status bar color
-    wattron(rankingWin->window, COLOR_PAIR(rankingWin->color));
+    BENCH* bench = (BENCH*)renderer->data;
 
-    // Draw border around status bar
-    box(rankingWin->window, 0, 0);
+    long long mark = MonotonicNs();
+    CleanDrawnCells(bench->playWin);
+    ProfileMark(game->profile, PROFILE_CLEAR, &mark);
+    DrawPlayArea(bench->playWin, game);
+    ProfileMark(game->profile, PROFILE_DRAWING, &mark);
+}
 
-    // display level kind info
-    char levelInfo[50], rankingInfo[50];
-    snprintf(levelInfo, sizeof(levelInfo), "Level: %s", level);
 
-    // Display status info
-    mvwprintw(rankingWin->window, 1, 2, playerName);
-    mvwprintw(rankingWin->window, 2, 2, levelInfo);
-    mvwprintw(rankingWin->window, 3, 2, "Nr Nick Pts Tm Lf");
+// Returns render backend of the benchmark, it doesn't wait between ticks
+RENDERER BenchRenderer(BENCH* bench)
+{
+    RENDERER renderer = { bench, BenchReadInput, BenchDrawFrame, false };
+    return renderer;
+}
 
-    Ranking** ranking = GetScores(level);
-    // display ranking for every player ever played
-    for (int i = 0; ranking[i] != NULL && i +4 < config->rows; i++)
-    {
-        snprintf(rankingInfo, sizeof(rankingInfo), "%d %s %d %.2f %d", ranking[i]->index, ranking[i]->nick, ranking[i]->points, ranking[i]->timeUsed, ranking[i]->lifeRemaining);
-        mvwprintw(rankingWin->window, i+4, 2, rankingInfo);
-    }
 
-    // Update display
-    wrefresh(rankingWin->window);
+// Returns play window that exists only as a framebuffer, without ncurses
+WIN* OffscreenWin(ARENA* arena, int rows, int cols, int color, int border)
+{
+    WIN* W = (WIN*)ArenaAlloc(arena, sizeof(WIN));
+
+    W->window = NULL;
+    W->x = 0;
+    W->y = 0;
+    W->rows = rows;
+    W->cols = cols;
+    W->color = color;
+    W->pen = color;
+    InitFramebuffer(arena, W, border);
+
+    return W;
 }
 
 
-//  Displaying number of gained stars, actual speed and controls
-void UpdateStatus(WIN* statusWin, Swallow* swallow, CONFIG_FILE* config)
-{
-	// Set status bar color
-	wattron(statusWin->window, COLOR_PAIR(statusWin->color));
 
-	// Draw border around status bar
-	box(statusWin->window, 0, 0);
 
-    char info[50];
-    snprintf(info, sizeof(info), "Number of gained stars: %d    Swallows speed: %d", swallow->wallet, swallow->speed);
-    char controls[] = "W (up), S (down), D (right), A (left) | O (slow down), P (go faster), SPACE (safe zone)";
+// Starts recording of a round to a new file in the replays folder, the round is played without it if the file cant be made
+void StartRecording(REPLAY* replay, CONFIG_FILE* config, char* level, char* playerName)
+{
+    char path[256], date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y%m%d-%H%M%S", localtime(&now));
 
-    // Display status info
-	mvwprintw(statusWin->window, 1, (config->cols-(sizeof(info)/sizeof(char)))/2, info);
+    mkdir(REPLAYS_DIR, 0755);
 
-	// Display controls
-	mvwprintw(statusWin->window, 3, (config->cols-(sizeof(controls)/sizeof(char)))/2, controls);
+    // rounds started in the same second get the next free number
+    replay->playing = false;
+    replay->ticks = 0;
+    replay->file = NULL;
+    for (int number = 1; !replay->file && number <= 100; number++)
+    {
+        snprintf(path, sizeof(path), "%s/%s-%s-%d.replay", REPLAYS_DIR, level, date, number);
+        replay->file = fopen(path, "wbx");
+    }
+    if (!replay->file)
+        return;
 
-	// Update display
-	wrefresh(statusWin->window);
+    REPLAY_HEADER header = { 0 };
+    memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+    header.version = REPLAY_VERSION;
+    snprintf(header.level, sizeof(header.level), "%s", level);
+    snprintf(header.player, sizeof(header.player), "%s", playerName);
+    header.seed = config->seed;
+    header.configSize = sizeof(CONFIG_FILE);
+
+    fwrite(&header, sizeof(header), 1, replay->file);
+    fwrite(config, sizeof(CONFIG_FILE), 1, replay->file);
 }
 
 
-// Display time left and actual health points
-void UpdateLifeInfo(WIN* lifeinfo, Swallow* swallow, float *timer, CONFIG_FILE* config)
+// Opens replay file to play it, fills the config, level and players nick of the recorded session, returns false if the file cant be used
+bool OpenReplay(REPLAY* replay, char* path, CONFIG_FILE* config, REPLAY_HEADER* header)
 {
-    // Set status bar color
-	wattron(lifeinfo->window, COLOR_PAIR(lifeinfo->color));
-
-	// Draw border around status bar
-	box(lifeinfo->window, 0, 0);
+    replay->playing = true;
+    replay->ticks = 0;
+    replay->file = fopen(path, "rb");
+    if (!replay->file)
+    {
+        fprintf(stderr, "Can't open the replay %s.\n", path);
+        return false;
+    }
 
-    char life[50];
-    snprintf(life, sizeof(life), "Health Points: %d", swallow->hp);
-    char time[50];
-    snprintf(time, sizeof(time), "Time Left: %.1f", *timer);
+    if (fread(header, sizeof(REPLAY_HEADER), 1, replay->file) != 1 || memcmp(header->magic, REPLAY_MAGIC, sizeof(header->magic)) != 0)
+    {
+        fprintf(stderr, "%s is not a replay file.\n", path);
+        fclose(replay->file);
+        return false;
+    }
 
-    // Display life info
-	mvwprintw(lifeinfo->window, 1, OFFX, life);
+    if (header->version != REPLAY_VERSION || header->configSize != sizeof(CONFIG_FILE) || fread(config, sizeof(CONFIG_FILE), 1, replay->file) != 1)
+    {
+        fprintf(stderr, "The replay %s was recorded by another version of the game.\n", path);
+        fclose(replay->file);
+        return false;
+    }
 
-	// Display time left
-	mvwprintw(lifeinfo->window, 1, config->cols/3-OFFX, time);
+    // a broken replay could make the game divide by zero or take all the memory
+    const CONFIG_KEY* wrong = ValidateConfig(config);
+    if (wrong)
+    {
+        fprintf(stderr, "The replay %s has a wrong \"%s\" value.\n", path, wrong->name);
+        fclose(replay->file);
+        return false;
+    }
 
-	// Update display
-	wrefresh(lifeinfo->window);
+    header->level[sizeof(header->level) - 1] = '\0';
+    header->player[sizeof(header->player) - 1] = '\0';
+    return true;
 }
 
 
-// Say goodbye to the player
-void EndScreen(WIN* playWin, CONFIG_FILE* config)
+// Returns the key of the tick: records the players key, or gives the recorded one back when the replay is played
+int ReplayKey(REPLAY* replay, int key)
 {
-    CleanWin(playWin, BORDER);
+    if (!replay || !replay->file)
+        return key;
 
-    // Set text color
-	wattron(playWin->window, COLOR_PAIR(END_COLOR));
+    replay->ticks++;
 
-	// Draw border around text
-	box(playWin->window, 0, 0);
+    if (!replay->playing)
+    {
+        fputc(key >= 0 && key < REPLAY_NO_KEY ? key : REPLAY_NO_KEY, replay->file);
+        return key;
+    }
 
-    char endText[] = "Bye bye, thanks for playing!";
+    // Player can stop the replay, the end of the file ends it too
+    if (key == ESCAPE)
+        return ESCAPE;
 
-    //Display end text
-	mvwprintw(playWin->window, config->rows/2, (config->cols-(sizeof(endText)/sizeof(char)))/2, endText);
+    int recorded = fgetc(replay->file);
+    if (recorded == EOF)
+        return ESCAPE;
 
-	// Update display
-	wrefresh(playWin->window);
-    sleep(1);
+    return recorded == REPLAY_NO_KEY ? ERR : recorded;
 }
 
 
-// Ask player if he want to try again
-void AgainScreen(WIN* playWin, char *resultText, CONFIG_FILE* config)
+// Closes the replay file
+void CloseReplay(REPLAY* replay)
 {
-    CleanWin(playWin, BORDER);
+    if (replay->file)
+        fclose(replay->file);
+    replay->file = NULL;
+}
 
-    // Set text color
-	wattron(playWin->window, COLOR_PAIR(AGAIN_COLOR));
 
-	// Draw border around text
-	box(playWin->window, 0, 0);
+// Main loop, here the whole game happens. Keys go through the replay (NULL - session isnt recorded)
+void Update(GAME* game, RENDERER* renderer, REPLAY* replay)
+{
+    int ch;
 
-    char* question = "Click 'r' to play again and 'q' if you don't ;)";
+    // set values from config
+    game->timer = game->config->start_time;
 
-    //Display result text
-	mvwprintw(playWin->window, config->rows/2-2, (config->cols-(sizeof(resultText)/sizeof(char)))/2.2f, resultText);
-	mvwprintw(playWin->window, config->rows/2, (config->cols-(sizeof(question)/sizeof(char)))/3.2f, question);
+    // Ticks have fixed length, the accumulator collects real time that still has to be simulated
+    long long tickLength = 1000000000LL / game->config->tick_rate;
+    long long accumulator = tickLength;// first tick happens right away
+    long long previous = MonotonicNs();
+    bool running = true;
 
-	// Update display
-	wrefresh(playWin->window);
-}
+#ifdef DEBUG_ALLOCATIONS
+    long allocationsBefore = allocationCount;
+#endif
 
+    if (game->trace)
+        StartTrace(game->trace, game);
+    if (game->telemetry)
+        StartRound(game->telemetry, game);
 
-// Sort ranking list from the highest to the lowest point value (bubble sort)
-void SortRankingList(Ranking** rankinglist)
-{
-    for (int i = 0; rankinglist[i] != NULL; i++)
+    while(running)// main loop
     {
-        for (int j = 0; rankinglist[j+1] != NULL; j++)
+        if (renderer->realTime)
         {
-            // check if ranking points on left are lower than the points at the right
-            if (rankinglist[j]->points < rankinglist[j+1]->points)
+            long long now = MonotonicNs();
+            accumulator += now - previous;
+            previous = now;
+
+            // wait only for the part of the tick that isn't used yet (frame cost is already counted)
+            if (accumulator < tickLength)
             {
-                // swap places of rankings
-                Ranking* tempRanking = rankinglist[j];
+                long long wait = tickLength - accumulator;
+                struct timespec pause = { wait / 1000000000LL, wait % 1000000000LL };
+                nanosleep(&pause, NULL);
+                continue;
+            }
+        }
+        else
+            accumulator = tickLength;
+        long long frameStart = game->telemetry ? MonotonicNs() : 0;
 
-                rankinglist[j] = rankinglist[j+1];
-                rankinglist[j]->index = j+1;
+        // simulate every tick that should already happen, player input goes to the first of them
+        int ticks = 0;
+        while (accumulator >= tickLength && ticks < MAX_CATCHUP_TICKS)
+        {
+            long long mark = game->profile ? MonotonicNs() : 0;
+            ch = ticks == 0 ? renderer->ReadInput(renderer) : ERR;// get players input
+            if (ticks == 0)
+                ProfileMark(game->profile, PROFILE_INPUT, &mark);
+            ch = ReplayKey(replay, ch);
 
-                rankinglist[j + 1] = tempRanking;
-                rankinglist[j+1]->index= j+2;
+            if (!StepGame(game, ch))
+            {
+                running = false;
+                break;
             }
+
+            accumulator -= tickLength;
+            ticks++;
         }
+
+        // if we are too late, forget the ticks that can't be caught up
+        if (accumulator >= tickLength)
+            accumulator %= tickLength;
+
+        if (running)
+            renderer->DrawFrame(renderer, game);
+
+        if (game->trace)
+            TraceFrame(game->trace, game);
+        if (game->telemetry)
+            PublishTelemetry(game->telemetry, game, ticks, MonotonicNs() - frameStart);
     }
+
+#ifdef DEBUG_ALLOCATIONS
+    game->loopAllocations = allocationCount - allocationsBefore;
+#endif
 }
 
 
-// Saving changed ranking to the file
-void SaveRanking(Ranking** ranking, char* level)
+// Plays a single game without terminal and prints its result
+int RunHeadless(char* level)
 {
-    // make address
-    char address[100];
-    snprintf(address, sizeof(address), "./rankings/%s", level);
+    char configAdress[100];
+    LevelAddress(level, configAdress);
 
-    FILE* f = fopen(address, "w");
-    
-    for (int i = 0; ranking[i] != NULL; i++) // save each ranking
-    {
-        fprintf(f, "%d %s %d %f %d\n", ranking[i]->index, ranking[i]->nick, ranking[i]->points, ranking[i]->timeUsed, ranking[i]->lifeRemaining);
-    }
-    fclose(f);
+    CONFIG_FILE* config = getConfigInfo(configAdress);
+    ARENA arena = InitArena(GameArenaSize(config));
+    RENDERER renderer = NullRenderer();
+    GAME game;
+
+    StartTelemetry(level ? level : "default", "headless");
+    InitGame(&game, &arena, config, NULL);
+    Update(&game, &renderer, NULL);
+
+    printf("%s: %s, wallet %d, hp %d, time used %.1f\n",
+        level ? level : "default",
+        game.swallow->hp > 0 ? "won" : "lost",
+        game.swallow->wallet,
+        game.swallow->hp,
+        config->start_time - game.timer);
+
+#ifdef DEBUG_ALLOCATIONS
+    printf("heap allocations in the game loop: %ld\n", game.loopAllocations);
+#endif
+
+    FreeArena(&arena);
+    free(config);
+    return 0;
 }
 
 
-// add the best score or change if exist to the payer in ranking
-void AddScore(Swallow* swallow, char playerName[], char* level, CONFIG_FILE* config, float * timer)
+// Plays every level for ticks ticks with random keys and prints the cost of every part of a tick, "--bench [ticks]"
+int RunBench(int ticks)
 {
-    Ranking** rankingList = GetScores(level);
-    bool found = false;
-    int i = 0;
-    while (rankingList[i] != NULL)
+    if (ticks <= 0)
+        ticks = BENCH_TICKS;
+
+    // Default config first, then the levels in alphabetical order
+    RefreshLevels(&levelCatalog);
+    int levels = levelCatalog.count;
+
+    printf("%-10s %7s %10s", "level", "ticks", "ticks/s");
+    for (int part = 0; part < PROFILE_PARTS; part++)
+        printf(" %8s", profileParts[part]);
+    printf("   (ns per tick)\n");
+
+    for (int level = -1; level < levels; level++)
     {
-        if (strcmp(rankingList[i]->nick, playerName) == 0)
+        CONFIG_FILE* config = level < 0 ? getConfigInfo(".conf") : LevelConfig(&levelCatalog, level);
+
+        ARENA arena = InitArena(ARENA_SIZE(sizeof(WIN)) + FramebufferArenaSize(config->rows, config->cols) + GameArenaSize(config));
+        WIN* playWin = OffscreenWin(&arena, config->rows, config->cols, PLAY_COLOR, BORDER);
+        size_t roundStart = arena.used;
+
+        BENCH bench = { .playWin = playWin };
+        SeedRandom(&bench.keys, BENCH_SEED, KEYS_STREAM);
+        RENDERER renderer = BenchRenderer(&bench);
+        PROFILE profile = { 0 };
+
+        // Sessions are played one after another till there is enough ticks
+        long long start = MonotonicNs();
+        while (profile.ticks < ticks)
         {
-            found = true;
-            // if the score is better, change the score
-            if (rankingList[i]->points < swallow->wallet)
-            {
-                rankingList[i]->points = swallow->wallet;
-                rankingList[i]->timeUsed = config->start_time - *timer;
-                rankingList[i]->lifeRemaining = swallow->hp;
-            }
-            break;
+            arena.used = roundStart;
+            ResetFramebuffer(playWin);
+
+            GAME game;
+            InitGame(&game, &arena, config, playWin);
+            game.profile = &profile;
+            Update(&game, &renderer, NULL);
         }
-        i++;
-    }
+        double seconds = (MonotonicNs() - start) / 1e9;
 
-    // Add new Player if this one doesnt exist
-    if (!found)
-    {
-        rankingList[i] = (Ranking*)malloc(sizeof(Ranking));
-        rankingList[i]->index = i + 1;
-        strcpy(rankingList[i]->nick, playerName);
-        rankingList[i]->points = swallow->wallet;
-        rankingList[i]->timeUsed = config->start_time - *timer;
-        rankingList[i]->lifeRemaining = swallow->hp;
-        rankingList[i + 1] = NULL;
+        printf("%-10s %7ld %10.0f", level < 0 ? "default" : levelCatalog.levels[level].name, profile.ticks, profile.ticks / seconds);
+        for (int part = 0; part < PROFILE_PARTS; part++)
+            printf(" %8.0f", (double)profile.ns[part] / profile.ticks);
+        printf("\n");
+
+        FreeArena(&arena);
+        if (level < 0)
+            free(config);
     }
+    FreeLevels(&levelCatalog);
 
-    SortRankingList(rankingList);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("peak memory: %ld KB\n", usage.ru_maxrss);
 
-    SaveRanking(rankingList, level);
+    return 0;
 }
 
 
-// Give feedback for player of his actual playthrough
-void PlayAgain(WIN* playWin,WIN* rankingWin, Swallow* swallow, bool* isPlaying, CONFIG_FILE* config, char* playerName, char* level, float* timer)
-{
-    int ch;
-    char* resultText;
-    // write the result
-    if (swallow->hp > 0)
-    {
-        resultText = "You won, congarts!";
-        AddScore(swallow, playerName, level, config, timer);
-    }
-    else
-        resultText = "You have lost!";
+typedef struct {                // Result of a single session of the batch, the same values as the ranking keeps
 
-    RankingStatus(rankingWin, config, level, playerName);
-    AgainScreen(playWin, resultText, config);
+    int seed;                   // Seed of the session
+    bool won;                   // Swallow survived till the end of the time
+    int points;                 // Gained stars
+    int lifeRemaining;          // Health points at the end
+    float timeUsed;             // Time of the session
 
-    // wait for players decision to continue or end the game
-    while(1)
-    {
-        ch = wgetch(playWin->window);
-        if(ch == ESCAPE)
-        {
-            *isPlaying = false;
-            break;
-        }
-        else if(ch == REPEAT)
-            break;
-    }
+} SESSION_RESULT;
+
+typedef struct {                // Sessions of the batch, shared by the worker threads
+
+    CONFIG_FILE* config;        // Config of the level, every worker plays its own copy with the seed of the session
+    SESSION_RESULT* results;    // Result of every session, written only by the worker that played it
+    int count;                  // Number of sessions
+    int next;                   // Next session to play, taken atomically
+
+} SESSIONS;
+
+
+// Returns result of the session as a score of the ranking
+Ranking SessionScore(SESSION_RESULT* result)
+{
+    Ranking score = { .points = result->points, .timeUsed = result->timeUsed, .lifeRemaining = result->lifeRemaining };
+    return score;
 }
 
 
-// Check if the config file exist
-bool CheckConfigName(char** namesList, char fileName[100])
+// Plays sessions of the batch till there is none left (worker thread)
+void* BatchWorker(void* data)
 {
-    for (int i = 0; i < MAX_LEVELS_COUNT && namesList[i]; i++)
-        if (strcmp(namesList[i], fileName)==0)
-            return true;
+    SESSIONS* sessions = (SESSIONS*)data;
+    CONFIG_FILE config = *sessions->config;
+
+    // Every worker has its own memory, game and random player, nothing is shared but the results
+    ARENA arena = InitArena(GameArenaSize(&config));
+    BENCH player = { NULL };
+    RENDERER renderer = { &player, BenchReadInput, NullDrawFrame, false };
+
+    int session;
+    while ((session = __atomic_fetch_add(&sessions->next, 1, __ATOMIC_RELAXED)) < sessions->count)
+    {
+        arena.used = 0;
+        config.seed = sessions->config->seed + session;
+        SeedRandom(&player.keys, config.seed, KEYS_STREAM);
+
+        // sessions run at the same time, so they dont write to the trace and telemetry
+        GAME game;
+        InitGame(&game, &arena, &config, NULL);
+        game.trace = NULL;
+        game.telemetry = NULL;
+        Update(&game, &renderer, NULL);
+
+        SESSION_RESULT* result = &sessions->results[session];
+        result->seed = config.seed;
+        result->won = game.swallow->hp > 0;
+        result->points = game.swallow->wallet;
+        result->lifeRemaining = game.swallow->hp;
+        result->timeUsed = config.start_time - game.timer;
+    }
 
-    return false;
+    FreeArena(&arena);
+    return NULL;
 }
 
 
-// Form for player to get level and nick
-void AskPlayer(char* playerName, char configAdress[100], char* level)
+// Plays count sessions of the level on threads workers with random keys and seeds following the one of the level, "--batch level [count] [threads]"
+int RunBatch(char* level, int count, int threads)
 {
-    DIR* dir;
-    struct dirent* plik;
-    char fileName[100];
+    char configAdress[100];
+    LevelAddress(level, configAdress);
+    CONFIG_FILE* config = getConfigInfo(configAdress);
 
-    char** namesList = (char**)malloc(sizeof(char*)*MAX_LEVELS_COUNT);// Allocate memory for names
-    for (int i = 0; i < MAX_LEVELS_COUNT; i++)
-        namesList[i] = NULL;
+    if (count <= 0)
+        count = BATCH_SESSIONS;
+    if (threads <= 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > count)
+        threads = count;
 
-    // ask for players nick
-    printf("Podaj nazwę gracza: \n");
-    scanf("%s", playerName);
+    SESSIONS sessions = { config, (SESSION_RESULT*)malloc(count * sizeof(SESSION_RESULT)), count, 0 };
+    pthread_t* workers = (pthread_t*)malloc(threads * sizeof(pthread_t));
 
-    // get config file address for specified level
-    if (dir = opendir("./levels/"))
-    {
-        printf("\nWybierz poziom trudności:\n");
+    // kernel is chosen before the workers start, so they only read it
+    proximityKernel = ChooseProximityKernel();
 
-        int i = 0;
-        while ((plik = readdir(dir)) != NULL && i < MAX_LEVELS_COUNT)
+    long long start = MonotonicNs();
+    for (int i = 0; i < threads; i++)
+    {
+        if (pthread_create(&workers[i], NULL, BatchWorker, &sessions) != 0)
         {
-            if (strcmp(plik->d_name, ".") == 0 || strcmp(plik->d_name, "..") == 0)
-                continue;
+            fprintf(stderr, "Can't start the worker thread %d.\n", i);
+            exit(1);
+        }
+    }
+    for (int i = 0; i < threads; i++)
+        pthread_join(workers[i], NULL);
+    double seconds = (MonotonicNs() - start) / 1e9;
+
+    // Summary of every session
+    int won = 0;
+    double points = 0, life = 0, timeUsed = 0;
+    SESSION_RESULT* best = &sessions.results[0];
+    Ranking bestScore = SessionScore(best);
+    for (int i = 0; i < count; i++)
+    {
+        SESSION_RESULT* result = &sessions.results[i];
+        won += result->won;
+        points += result->points;
+        life += result->lifeRemaining;
+        timeUsed += result->timeUsed;
+
+        // best session is chosen with the order of the ranking
+        Ranking score = SessionScore(result);
+        if (CompareScores(&score, &bestScore) < 0)
+        {
+            best = result;
+            bestScore = score;
+        }
+    }
 
-            printf("%s\n", plik->d_name);
+    printf("%s: %d sessions on %d threads in %.3f s (%.0f sessions/min)\n",
+        level ? level : "default", count, threads, seconds, seconds > 0 ? count / seconds * 60 : 0);
+    printf("won %d, lost %d\n", won, count - won);
+    printf("average: wallet %.2f, hp %.2f, time used %.2f\n", points / count, life / count, timeUsed / count);
+    printf("best: seed %d, wallet %d, hp %d, time used %.1f\n", best->seed, best->points, best->lifeRemaining, best->timeUsed);
 
-            namesList[i] = malloc(strlen(plik->d_name) + 1);
-            strcpy(namesList[i], plik->d_name);
+    free(workers);
+    free(sessions.results);
+    free(config);
+    return 0;
+}
 
-            i++;
-        }
 
-        closedir(dir);
-        scanf("%s", fileName);
-        strcat(configAdress, "./levels/");
-        strcat(configAdress, fileName);
-    }
-    else
-        strcpy(configAdress, ".conf"); // if cant open folder, set config file as default
+// Plays a recorded session again, on the screen in real time or as fast as possible without drawing, "--replay file [--fast]"
+int RunReplay(char* path, bool fast)
+{
+    REPLAY replay;
+    REPLAY_HEADER header;
+    CONFIG_FILE* config = (CONFIG_FILE*)malloc(sizeof(CONFIG_FILE));
 
-    if (CheckConfigName(namesList, fileName))
+    if (!OpenReplay(&replay, path, config, &header))
     {
-        strcpy(level, fileName);// set file name if level exist
+        free(config);
+        return 1;
     }
-    else // if cant open find level, set config file as default
+
+    ARENA arena = InitArena((fast ? 0 : ViewArenaSize(config)) + GameArenaSize(config));
+    RENDERER renderer = NullRenderer();
+    VIEW view = { 0 };
+    PROFILE profile = { 0 };
+    GAME game;
+
+    StartTelemetry(header.level, header.player);
+
+    if (fast)
+        InitGame(&game, &arena, config, NULL);
+    else
     {
-        strcpy(configAdress, ".conf");
-        strcpy(level, "default");
+        WINDOW* mainWin = Start();
+        InitView(&view, &arena, mainWin, config);
+        view.level = header.level;
+        view.playerName = header.player;
+        CleanView(&view);
+        InitGame(&game, &arena, config, view.playWin);
+        game.profile = &profile;
+        wrefresh(mainWin);
+
+        renderer = NcursesRenderer(&view);
+        RankingStatus(view.rankingWin, config, header.level, header.player);
     }
 
-
-    free(namesList);// free allocated memory
+    long long start = MonotonicNs();
+    Update(&game, &renderer, &replay);
+    double seconds = (MonotonicNs() - start) / 1e9;
+
+    if (!fast)
+        endwin();
+
+    printf("%s (%s): %s, wallet %d, hp %d, time used %.1f\n",
+        header.level,
+        header.player,
+        game.swallow->hp > 0 ? "won" : "lost",
+        game.swallow->wallet,
+        game.swallow->hp,
+        config->start_time - game.timer);
+    printf("%ld ticks in %.3f s (%.0f ticks/s)\n", replay.ticks, seconds, seconds > 0 ? replay.ticks / seconds : 0);
+
+    CloseReplay(&replay);
+    FreeArena(&arena);
+    FreeRankings();
+    free(config);
+    return 0;
 }
 
-// Main loop, here the whole game happens
-void Update(WIN *playWin, WIN *statusWin,WIN* lifeWin,WIN* rankingWin,CONFIG_FILE* config, Swallow* swallow, Star** stars, Hunter** hunters, SafeZone* safeZone, TAXI* taxi, Boss* boss, char* level, char playerName[100], float* timer)
+// Measures the proximity kernels on count random objects and compares them with the scalar one, "--kernel-bench [count]"
+int RunKernelBench(int count)
 {
-    int ch;
+    if (count <= 0)
+        count = KERNEL_BENCH_COUNT;
+
+    ARENA arena = InitArena(2 * BatchArenaSize(count));
+    BATCH* batch = InitBatch(&arena, count);
+    BATCH* expected = InitBatch(&arena, count);
+
+    // Objects around the middle of a big play area, about every tenth of them in range
+    RANDOM random;
+    SeedRandom(&random, 1, 0);
+    batch->count = count;
+    for (int k = 0; k < count; k++)
+    {
+        batch->x[k] = Random(&random) % 300;
+        batch->y[k] = Random(&random) % 100;
+        batch->hitRange[k] = (Random(&random) % 40) * (Random(&random) % 40);
+        batch->seeRange[k] = Random(&random) % 2 ? 4 * batch->hitRange[k] : -1;
+    }
 
-    // set values from config
-    *timer = config->start_time;
-    srand(config->seed);
+    struct {
+        const char* name;
+        PROXIMITY_KERNEL kernel;
+        bool supported;
+    } kernels[] = {
+        { "scalar", ProximityScalar, true },
+#if defined(__x86_64__) || defined(__i386__)
+        { "sse2", ProximitySse2, __builtin_cpu_supports("sse2") },
+        { "avx2", ProximityAvx2, __builtin_cpu_supports("avx2") },
+#endif
+    };
+
+    // Every kernel tests about 100 million objects
+    int rounds = 100000000 / count + 1;
+    double scalarNs = 0;
+    expected->count = count;
+    ProximityScalar(batch, 150, 50);
+    memcpy(expected->hit, batch->hit, MASK_WORDS(count) * sizeof(unsigned));
+    memcpy(expected->see, batch->see, MASK_WORDS(count) * sizeof(unsigned));
+
+    printf("%d objects, %d rounds, kernel used by the game: ", count, rounds);
+    PROXIMITY_KERNEL chosen = ChooseProximityKernel();
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++)
+        if (kernels[i].kernel == chosen)
+            printf("%s\n", kernels[i].name);
+
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++)
+    {
+        if (!kernels[i].supported)
+        {
+            printf("%-8s not supported by this processor\n", kernels[i].name);
+            continue;
+        }
 
-    RankingStatus(rankingWin, config, level, playerName);
+        long long start = MonotonicNs();
+        for (int round = 0; round < rounds; round++)
+            kernels[i].kernel(batch, 150 + round % 2, 50);
+        double ns = (double)(MonotonicNs() - start) / rounds / count;
+        if (i == 0)
+            scalarNs = ns;
 
-    while(1)// main loop
-    {
-        ch = wgetch(playWin->window);// get players input
+        // Results of the last round (point 150 + 1) are compared once more with the scalar kernel at the start point
+        kernels[i].kernel(batch, 150, 50);
+        bool same = memcmp(batch->hit, expected->hit, MASK_WORDS(count) * sizeof(unsigned)) == 0 &&
+            memcmp(batch->see, expected->see, MASK_WORDS(count) * sizeof(unsigned)) == 0;
 
-        CleanWin(playWin, BORDER);
+        printf("%-8s %6.3f ns per object, %5.2fx scalar, %s\n", kernels[i].name, ns, scalarNs / ns, same ? "same masks" : "DIFFERENT MASKS");
+    }
 
-        *timer -= 0.1;// decrease games time
+    FreeArena(&arena);
+    return 0;
+}
 
-        UpdateLifeInfo(lifeWin, swallow, timer, config);
 
-        // defining exiting protocol
-        if (ch == ESCAPE || *timer <= 0 || swallow->hp <= 0) break;
-        else if (*timer <= 0) break;
-        else PlayerMovement(swallow, ch, stars, hunters, config, timer, safeZone, taxi);
+// Removes the ranking files of the stress test level
+void RemoveStressRanking()
+{
+    const char* extensions[] = { ".rank", ".journal", ".lock" };
+    char address[150];
 
-        // draw every star
-        for (int i = 0; i < config->max_stars_count; i++)
-            DrawStars(playWin, stars[i], swallow, config);
+    for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++)
+    {
+        RankingAddress(address, sizeof(address), STRESS_LEVEL, extensions[i]);
+        remove(address);
+    }
+}
 
-        MoveBoss(boss, swallow, config, safeZone, timer);
 
-        // swallow and taxi procedure, dependent of stage
-        if (taxi->stage >= 0 && taxi->stage <= 3)
-        {
-            if (taxi->stage == 1)// if swallow is being caries by taxi, it should be in his position
-            {
-                swallow->x = taxi->x;
-                swallow->y = taxi->y;
-            }
-            else
-                DrawSwallow(playWin, swallow);
+// Starts writers processes that record scores to one ranking at the same time and checks that no score was lost, "--ranking-stress [writers] [scores]"
+int RunRankingStress(int writers, int scores)
+{
+    if (writers <= 0)
+        writers = STRESS_WRITERS;
+    if (scores <= 0)
+        scores = STRESS_SCORES;
 
-            MoveTaxi(taxi, swallow, safeZone, config);
+    mkdir("rankings", 0755);
+    RemoveStressRanking();
 
-            if(safeZone->active)
-                DrawSafeZone(safeZone, swallow, config);
+    // every writer has its own players and all of them improve one shared player
+    long long start = MonotonicNs();
+    for (int writer = 0; writer < writers; writer++)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("fork");
+            writers = writer;
+            break;
         }
-        else
-            DrawSwallow(playWin, swallow);
+        if (pid > 0)
+            continue;
 
-        // move, draw each hunter
-        for (int i = 0; i < config->max_hunters_count; i++)
+        for (int k = 0; k < scores; k++)
         {
-            if (*timer >= i * config->start_time / config->max_hunters_count)
-                continue;
-            MoveHunter(hunters[i], swallow, config, safeZone, timer);
+            Ranking score = { 0 };
+            snprintf(score.nick, sizeof(score.nick), "w%d-%d", writer, k);
+            score.points = k + 1;
+            score.timeUsed = k;
+            RecordScore(STRESS_LEVEL, &score);
+
+            snprintf(score.nick, sizeof(score.nick), "shared");
+            score.points = writer * scores + k + 1;
+            RecordScore(STRESS_LEVEL, &score);
         }
-        
-        UpdateStatus(statusWin, swallow, config);
-
-        wrefresh(playWin->window);// refresh changes on the screen
-        flushinp();
-        usleep(REFRESH_TIME*1000);// refresh cooldown for 0.1 second
+        FreeRankings();
+        _exit(0);
     }
+    while (wait(NULL) > 0);
+    double seconds = (MonotonicNs() - start) / 1e9;
+
+    // every score has to be in the ranking, read again from the files
+    RANKING_TABLE* table = GetRanking(STRESS_LEVEL);
+    char nick[RANKING_NICK];
+    int lost = 0;
+    for (int writer = 0; writer < writers; writer++)
+        for (int k = 0; k < scores; k++)
+        {
+            snprintf(nick, sizeof(nick), "w%d-%d", writer, k);
+            int record = FindPlayer(table, nick);
+            if (record < 0 || table->records[record].points != k + 1)
+                lost++;
+        }
+    int shared = FindPlayer(table, "shared");
+    bool sharedBest = shared >= 0 && table->records[shared].points == writers * scores;
+
+    printf("%d writers, %d scores each: %.0f scores/s, %d players, %d lost, best shared score %s\n",
+        writers, scores, 2.0 * writers * scores / seconds, table->count, lost, sharedBest ? "kept" : "LOST");
+
+    FreeRankings();
+    RemoveStressRanking();
+    return lost == 0 && sharedBest ? 0 : 1;
 }
 
+// Main function
+int main(int argc, char* argv[])
+{
+    // "--trace file.json|file.csv" before the other arguments writes a timeline of every frame of the games
+    static TRACE trace;
+    if (argc >= 3 && strcmp(argv[1], "--trace") == 0)
+    {
+        if (!OpenTrace(&trace, argv[2]))
+        {
+            printf("The trace file %s can't be written.\n", argv[2]);
+            return 1;
+        }
+        activeTrace = &trace;
+        atexit(CloseActiveTrace);
+
+        argc -= 2;
+        argv += 2;
+    }
 
-// Free allocated memory
-void CleanupGameResources(WIN* rankingWin, WIN* lifeWin, WIN* playWin, WIN* statusWin, Swallow* swallow, Star** stars, Hunter** hunters, Boss* boss, SafeZone* safeZone, TAXI* taxi, float* timer, CONFIG_FILE* config) {
-    free(swallow);
+    // "--headless [level]" plays without terminal
+    if (argc >= 2 && strcmp(argv[1], "--headless") == 0)
+        return RunHeadless(argc >= 3 ? argv[2] : NULL);
 
-    for (int i = 0; i < config->max_stars_count; i++)
-        free(stars[i]);
-    for (int i = 0; i < config->max_hunters_count; i++)
-        free(hunters[i]);
+    // "--replay file [--fast]" plays a recorded session again
+    if (argc >= 3 && strcmp(argv[1], "--replay") == 0)
+        return RunReplay(argv[2], argc >= 4 && strcmp(argv[3], "--fast") == 0);
 
-    free(stars);
-    free(hunters);
-    free(boss);
-    free(safeZone);
-    free(taxi);
-    free(timer);
-    free(rankingWin);
-    free(lifeWin);
-    free(playWin);
-    free(statusWin);
-}
+    // "--bench [ticks]" measures the game on every level
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0)
+        return RunBench(argc >= 3 ? atoi(argv[2]) : 0);
 
+    // "--batch level [count] [threads]" plays many sessions of the level at once
+    if (argc >= 3 && strcmp(argv[1], "--batch") == 0)
+        return RunBatch(argv[2], argc >= 4 ? atoi(argv[3]) : 0, argc >= 5 ? atoi(argv[4]) : 0);
+
+    // "--kernel-bench [count]" compares the proximity kernels
+    if (argc >= 2 && strcmp(argv[1], "--kernel-bench") == 0)
+        return RunKernelBench(argc >= 3 ? atoi(argv[2]) : 0);
+
+    // "--ranking-stress [writers] [scores]" records scores from many processes at once
+    if (argc >= 2 && strcmp(argv[1], "--ranking-stress") == 0)
+        return RunRankingStress(argc >= 3 ? atoi(argv[2]) : 0, argc >= 4 ? atoi(argv[3]) : 0);
+
+    // "--record" records every round of the game to the replays folder
+    bool record = argc >= 2 && strcmp(argv[1], "--record") == 0;
 
-// Main function
-int main()
-{
     char playerName[100], configAdress[100], level[50];
     AskPlayer(playerName, configAdress, level);
 
     CONFIG_FILE* config = getConfigInfo(configAdress);
+    StartTelemetry(level, playerName);
 
-    bool* isPlaying = (bool*)malloc(sizeof(bool));// allocate memory for bool that tells if we should close the game
-    *isPlaying = true;
+    bool isPlaying = true;// tells if we should close the game
+    long loopAllocations = 0;// heap allocations made by the game loops of every round
 
-    while (*isPlaying)
-    {
-        // setting deafult parameters and generating windows
-        WINDOW *mainWin = Start();
+    // one arena for the windows and every round of the game, sized from the config
+    ARENA arena = InitArena(ViewArenaSize(config) + GameArenaSize(config));
 
-        WIN *rankingWin = InitWin(mainWin,  config->rows,   20,             OFFY,                       OFFX + config->cols,        RANKING_COLOR,      BORDER, 0);
-        WIN *lifeWin =    InitWin(mainWin,  LIFEWINY,       config->cols/2, LIFEWINY - 1,               OFFY + config->cols / 4,    STAT_COLOR,         BORDER, 0);
-        WIN *playWin =    InitWin(mainWin,  config->rows,   config->cols,   OFFY,                       OFFX,                       PLAY_COLOR,         BORDER, 0);
-        WIN *statusWin =  InitWin(mainWin,  OFFY,           config->cols,   config->rows + OFFY,        OFFX,                       STAT_COLOR,         BORDER, 0);
+    // setting deafult parameters and generating windows
+    WINDOW *mainWin = Start();
 
-        Swallow* swallow = InitSwallow(playWin, config->cols/2,config->rows/2,0,-1,START_PLAYER_SPEED,SWALLOW_COLOR,config);//  create swallow
+    VIEW view = { 0 };
+    InitView(&view, &arena, mainWin, config);
+    view.level = level;
+    view.playerName = playerName;
+    PROFILE profile;
 
-        Boss* boss = (Boss*)malloc(sizeof(Boss));
-        SpawnBoss(boss, config, swallow);
-        UpdateBoss(boss, swallow, config);
+    // everything after this point belongs to a single round
+    size_t roundStart = arena.used;
+
+    // changes of the level file are used from the next round
+    LEVEL_WATCH watch;
+    WatchLevel(&watch, configAdress);
 
-        Star** stars = InitStars(playWin, STAR_COLOR, STAR2_COLOR, config);
-        
-        Hunter** hunters = InitHunters(playWin, HUNTER_COLOR, swallow, config);
+    while (isPlaying)
+    {
+        const char* reloadInfo = LevelChanged(&watch) ? ReloadLevel(configAdress, config, &arena, &view, mainWin, &roundStart) : NULL;
 
-        SafeZone* safeZone = (SafeZone*)malloc(sizeof(SafeZone));// allocate memory for safe zone
-        TAXI* taxi = (TAXI*)malloc(sizeof(TAXI));// allocate memory for taxi
+        // new round reuses the same memory and windows
+        arena.used = roundStart;
 
-        SetSafeZone(safeZone, swallow, false, config);
-        SetTaxi(taxi, swallow, config);
-        
-        wrefresh(mainWin);// Refresh main window to show changes
+        CleanView(&view);
+
+        GAME game = { 0 };
+        InitGame(&game, &arena, config, view.playWin);
+
+        // timings are measured from the start of every round
+        memset(&profile, 0, sizeof(profile));
+        game.profile = &profile;
+        view.showProfile = false;
 
-        float* timer = (float*)malloc(sizeof(float));// allocate memory for timer
+        wrefresh(mainWin);// Refresh main window to show changes
 
-        Update(playWin, statusWin, lifeWin, rankingWin, config, swallow, stars, hunters, safeZone, taxi, boss, level, playerName, timer);
+        RENDERER renderer = NcursesRenderer(&view);
 
-        PlayAgain(playWin, rankingWin, swallow, isPlaying, config, playerName, level, timer);
+        RankingStatus(view.rankingWin, config, level, playerName);
+        if (reloadInfo)
+        {
+            mvwprintw(view.rankingWin->window, 0, 2, "%s", reloadInfo);
+            wrefresh(view.rankingWin->window);
+        }
 
-        if(!(*isPlaying))
-            EndScreen(playWin, config);
+        // with --record every round can be played again with --replay
+        REPLAY replay = { 0 };
+        if (record)
+            StartRecording(&replay, config, level, playerName);
+        Update(&game, &renderer, record ? &replay : NULL);
+        CloseReplay(&replay);
 
-        endwin();// end of displaying any window
+        PlayAgain(view.playWin, view.rankingWin, game.swallow, &isPlaying, config, playerName, level, &game.timer);
 
-        CleanupGameResources(rankingWin, lifeWin, playWin, statusWin, swallow, stars, hunters, boss, safeZone, taxi, timer, config);
+        loopAllocations += game.loopAllocations;
     }
 
+    EndScreen(view.playWin, config);
+    StopWatch(&watch);
+
+    endwin();// end of displaying any window
+
+#ifdef DEBUG_ALLOCATIONS
+    printf("heap allocations in the game loops: %ld\n", loopAllocations);
+#endif
+
+    FreeArena(&arena);
+    FreeRankings();
+    FreeLevels(&levelCatalog);
+    free(config);
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,179 @@
+#include <stdio.h>                      // Standard input/output (printf)
+#include <stdlib.h>                     // Standard library (atoi)
+#include <string.h>                     // Names of the segments (strncmp, snprintf)
+#include <unistd.h>                     // Unix standard (usleep)
+#include <dirent.h>                     // Segments are found in /dev/shm
+#include <fcntl.h>                      // shm_open flags
+#include <signal.h>                     // kill(pid, 0) tells if the game still runs
+#include <errno.h>
+#include <time.h>                       // Monotonic clock of the rates
+#include <sys/mman.h>                   // Segments are mapped into memory to read them
+#include <sys/stat.h>
+#include "telemetry.h"                  // Layout of the segments, the same as the game writes
+
+#define SHM_FOLDER              "/dev/shm"  // Folder where Linux keeps POSIX shared memory
+#define DEFAULT_INTERVAL        1000    // Milliseconds between refreshes when they aren't given
+#define MAX_GAMES               1024    // Games shown at once
+
+typedef struct {                        // Last reading of a game, rates are counted from the difference
+
+    int pid;                            // Process of the game
+    long long time;                     // Time of the reading (nanoseconds)
+    long long ticks;                    // Ticks simulated till then
+    long long tests;                    // Collision tests till then
+
+} READING;
+
+
+// Returns monotonic time in nanoseconds
+long long MonotonicNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+
+// Returns the upper limit (microseconds) of the frame time that fraction of the frames didnt exceed, -1 if there are no frames
+long long FramePercentile(TELEMETRY_DATA* data, double fraction)
+{
+    long long frames = 0, counted = 0;
+    for (int bucket = 0; bucket < TELEMETRY_BUCKETS; bucket++)
+        frames += data->frameTimes[bucket];
+    if (frames == 0)
+        return -1;
+
+    for (int bucket = 0; bucket < TELEMETRY_BUCKETS; bucket++)
+    {
+        counted += data->frameTimes[bucket];
+        if (counted >= fraction * frames)
+            return 1LL << bucket;
+    }
+
+    return 1LL << (TELEMETRY_BUCKETS - 1);
+}
+
+
+// Reads the segment with the name, returns false if it isnt a segment of a running game
+bool ReadGame(const char* name, int* pid, TELEMETRY_DATA* data, bool* stale)
+{
+    char address[300];
+    snprintf(address, sizeof(address), "/%s", name);
+    *stale = false;
+
+    int fd = shm_open(address, O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    TELEMETRY* telemetry = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(TELEMETRY))
+        telemetry = (TELEMETRY*)mmap(NULL, sizeof(TELEMETRY), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (telemetry == MAP_FAILED)
+        return false;
+
+    // segment left by a game that ended without removing it
+    bool read = false;
+    if (memcmp(telemetry->magic, TELEMETRY_MAGIC, sizeof(telemetry->magic)) == 0 && telemetry->version == TELEMETRY_VERSION)
+    {
+        *pid = telemetry->pid;
+        if (kill(*pid, 0) != 0 && errno != EPERM)
+            *stale = true;
+        else
+            read = TelemetryRead(telemetry, data);
+    }
+
+    munmap(telemetry, sizeof(TELEMETRY));
+    return read;
+}
+
+
+// Prints every running game once, rates are counted from the previous readings
+void PrintGames(READING* readings, int* readingsCount)
+{
+    static READING current[MAX_GAMES];
+    int count = 0, stale = 0;
+
+    printf("%7s %-12s %-12s %5s %7s %4s %6s %6s %5s %5s %4s %9s %7s %7s\n",
+        "PID", "LEVEL", "PLAYER", "ROUND", "TICK/S", "HP", "WALLET", "TIME", "HUNT", "STARS", "BOSS", "TESTS/S", "P50 US", "P99 US");
+
+    DIR* dir = opendir(SHM_FOLDER);
+    struct dirent* file;
+    while (dir && (file = readdir(dir)) != NULL && count < MAX_GAMES)
+    {
+        if (strncmp(file->d_name, TELEMETRY_PREFIX, strlen(TELEMETRY_PREFIX)) != 0)
+            continue;
+
+        int pid;
+        bool dead;
+        TELEMETRY_DATA data;
+        if (!ReadGame(file->d_name, &pid, &data, &dead))
+        {
+            stale += dead;
+            continue;
+        }
+
+        // rates need the previous reading of the same game
+        READING* reading = &current[count++];
+        reading->pid = pid;
+        reading->time = MonotonicNs();
+        reading->ticks = data.ticks;
+        reading->tests = data.starTests + data.hunterTests;
+
+        double tickRate = 0, testRate = 0;
+        for (int i = 0; i < *readingsCount; i++)
+        {
+            if (readings[i].pid != pid || reading->time <= readings[i].time)
+                continue;
+            double seconds = (reading->time - readings[i].time) / 1e9;
+            tickRate = (reading->ticks - readings[i].ticks) / seconds;
+            testRate = (reading->tests - readings[i].tests) / seconds;
+        }
+
+        printf("%7d %-12.12s %-12.12s %5d %7.1f %4d %6d %6.1f %5d %5d %4s %9.0f %7lld %7lld\n",
+            pid, data.level, data.player, data.rounds, tickRate, data.hp, data.wallet, data.timer,
+            data.hunters, data.stars, data.boss ? "yes" : "no", testRate, FramePercentile(&data, 0.5), FramePercentile(&data, 0.99));
+    }
+    if (dir)
+        closedir(dir);
+
+    if (count == 0)
+        printf("no running games\n");
+    if (stale > 0)
+        printf("%d segments of games that ended (%s/%s<pid>)\n", stale, SHM_FOLDER, TELEMETRY_PREFIX);
+
+    memcpy(readings, current, count * sizeof(READING));
+    *readingsCount = count;
+}
+
+
+// Shows live counters of every running game, "pp1-top [--once] [interval in ms]"
+int main(int argc, char* argv[])
+{
+    static READING readings[MAX_GAMES];
+    int readingsCount = 0;
+    bool once = false;
+    int interval = DEFAULT_INTERVAL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--once") == 0)
+            once = true;
+        else if (atoi(argv[i]) > 0)
+            interval = atoi(argv[i]);
+    }
+
+    while (true)
+    {
+        // the screen is cleaned before every refresh
+        if (!once)
+            printf("\033[H\033[J");
+        PrintGames(readings, &readingsCount);
+        fflush(stdout);
+
+        if (once)
+            return 0;
+        usleep(interval * 1000);
+    }
+}
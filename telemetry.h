@@ -0,0 +1,87 @@
+// Layout of the live counters that a running game publishes in POSIX shared memory, read by pp1-top
+#ifndef PP1_TELEMETRY_H
+#define PP1_TELEMETRY_H
+
+#include <stdint.h>                     // Fixed width fields, the layout is the same in every program
+#include <stdbool.h>
+#include <stdatomic.h>                  // Sequence number of the seqlock
+
+#define TELEMETRY_MAGIC         "PP1T"  // First bytes of every telemetry segment
+#define TELEMETRY_VERSION       1       // Version of the telemetry layout
+#define TELEMETRY_PREFIX        "pp1-"  // Name of a segment is "/" TELEMETRY_PREFIX and the pid of the game (in /dev/shm on Linux)
+#define TELEMETRY_BUCKETS       20      // Frame time histogram: bucket 0 - below 1 us, bucket i - from 2^(i-1) to 2^i us, the last one - everything longer
+#define TELEMETRY_TRIES         1000    // Reads of a segment before the reader gives up on a game that keeps writing
+
+typedef struct {                        // Counters of a running game, always read and written as a whole
+
+    char level[50];                     // Played level
+    char player[100];                   // Name of the player
+    int32_t tickRate;                   // Ticks per second of the level
+    int32_t rounds;                     // Rounds started by the game
+    int64_t ticks;                      // Ticks simulated by every round
+    int64_t frames;                     // Frames drawn by every round
+    float timer;                        // Time left to the end of the round
+    int32_t hp;                         // Health of the swallow
+    int32_t wallet;                     // Gained stars
+    int32_t hunters;                    // Hunters that already joined the game
+    int32_t stars;                      // Stars in the game
+    int32_t boss;                       // Boss is on the screen (0 or 1)
+    int64_t starTests;                  // Stars tested for a collision by every round
+    int64_t hunterTests;                // Hunters tested for a collision by every round
+    uint32_t frameTimes[TELEMETRY_BUCKETS];// Frames by the time it took to simulate and draw them
+    int64_t updated;                    // CLOCK_MONOTONIC time of the last change (nanoseconds)
+
+} TELEMETRY_DATA;
+
+typedef struct {                        // Shared memory segment of a single game
+
+    char magic[4];                      // TELEMETRY_MAGIC
+    uint32_t version;                   // TELEMETRY_VERSION
+    int32_t pid;                        // Process of the game
+    _Atomic uint32_t sequence;          // Seqlock, odd while the game writes the data
+    TELEMETRY_DATA data;                // Counters of the game
+
+} TELEMETRY;
+
+
+// Returns bucket of the frame time histogram for the time in nanoseconds
+static inline int TelemetryBucket(long long ns)
+{
+    int bucket = 0;
+    for (long long us = ns / 1000; us > 0 && bucket < TELEMETRY_BUCKETS - 1; us >>= 1)
+        bucket++;
+    return bucket;
+}
+
+
+// Copies the counters into the segment, there is only one writer (the game) and it never waits
+static inline void TelemetryWrite(TELEMETRY* telemetry, const TELEMETRY_DATA* data)
+{
+    uint32_t sequence = atomic_load_explicit(&telemetry->sequence, memory_order_relaxed);
+
+    atomic_store_explicit(&telemetry->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    telemetry->data = *data;
+    atomic_store_explicit(&telemetry->sequence, sequence + 2, memory_order_release);
+}
+
+
+// Copies the counters from the segment, tries again while the game writes them. Returns false if it never got a whole copy
+static inline bool TelemetryRead(TELEMETRY* telemetry, TELEMETRY_DATA* data)
+{
+    for (int tries = 0; tries < TELEMETRY_TRIES; tries++)
+    {
+        uint32_t before = atomic_load_explicit(&telemetry->sequence, memory_order_acquire);
+        if (before & 1)
+            continue;
+
+        *data = telemetry->data;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&telemetry->sequence, memory_order_relaxed) == before)
+            return true;
+    }
+
+    return false;
+}
+
+#endif